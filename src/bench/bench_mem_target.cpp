@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2022, Sandflow Consulting LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Compares the throughput of mem_compressed_target::write() with the
+ * byte-wise std::back_inserter append it replaces.
+ */
+
+#include <kduc.h>
+#include <stdio.h>
+#include <time.h>
+#include <iterator>
+#include <vector>
+
+/* the previous implementation of mem_compressed_target::write() */
+class back_inserter_target {
+ public:
+  bool write(const kdu_core::kdu_byte* buf, int num_bytes) {
+    std::copy(buf, buf + num_bytes, std::back_inserter(this->buf));
+    return true;
+  }
+
+  std::vector<uint8_t> buf;
+};
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+template <class T>
+static double run(const kdu_core::kdu_byte* chunk,
+                  int chunk_size,
+                  size_t total_size) {
+  T target;
+  double start = now();
+
+  for (size_t written = 0; written < total_size; written += chunk_size)
+    target.write(chunk, chunk_size);
+
+  return total_size / (now() - start) / 1e6;
+}
+
+int main(void) {
+  const size_t total_size = 256 << 20;
+  const int chunk_sizes[] = {16, 256, 4096, 65536};
+  std::vector<kdu_core::kdu_byte> chunk(65536);
+
+  for (size_t i = 0; i < chunk.size(); i++)
+    chunk[i] = (kdu_core::kdu_byte)i;
+
+  printf("chunk_size,back_inserter_MBps,mem_compressed_target_MBps\n");
+
+  for (size_t i = 0; i < sizeof(chunk_sizes) / sizeof(chunk_sizes[0]); i++) {
+    double before = run<back_inserter_target>(&chunk[0], chunk_sizes[i],
+                                              total_size);
+    double after = run<mem_compressed_target>(&chunk[0], chunk_sizes[i],
+                                              total_size);
+
+    printf("%d,%.1f,%.1f\n", chunk_sizes[i], before, after);
+  }
+
+  return 0;
+}
@@ -0,0 +1,400 @@
+/*
+ * Copyright (c) 2022, Sandflow Consulting LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Measures encode and decode throughput over a matrix of synthetic images, and
+ * writes the results to stdout as a JSON array.
+ *
+ * usage: kduc_bench [--frames <count>] [--threads <max count>] [--quick]
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <kduc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct bench_config {
+  int width;
+  int height;
+  bool is_420;
+  int depth;
+  int stripe_height;                  /* 0 pushes and pulls the entire image as a single stripe */
+  int thread_count;
+  kdu_block_coder block_coder;
+} bench_config;
+
+typedef struct bench_result {
+  double seconds;
+  size_t codestream_size;
+} bench_result;
+
+typedef struct bench_image {
+  void *planes[3];
+  int heights[3];
+  int widths[3];
+  size_t sample_size;
+} bench_image;
+
+void exit_with_error(const char* msg) {
+  fprintf(stderr, "%s", msg);
+  fflush(stderr);
+  exit(-1);
+}
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int image_init(bench_image *img, const bench_config *cfg) {
+  img->sample_size = cfg->depth > 8 ? sizeof(int16_t) : 1;
+
+  for (int c = 0; c < 3; c++) {
+    int is_chroma = c > 0 && cfg->is_420;
+
+    img->widths[c] = is_chroma ? cfg->width / 2 : cfg->width;
+    img->heights[c] = is_chroma ? cfg->height / 2 : cfg->height;
+    img->planes[c] = malloc(img->widths[c] * img->heights[c] * img->sample_size);
+    if (! img->planes[c])
+      return 1;
+
+    /* smooth gradients with a little texture, so that the coded size is
+       representative of natural content */
+
+    for (int y = 0; y < img->heights[c]; y++) {
+      for (int x = 0; x < img->widths[c]; x++) {
+        int v = ((x + y + 40 * c) + ((x * 7 + y * 13) & 15)) << (cfg->depth - 8);
+        int i = y * img->widths[c] + x;
+
+        v &= (1 << cfg->depth) - 1;
+
+        if (img->sample_size == 1)
+          ((unsigned char*)img->planes[c])[i] = (unsigned char) v;
+        else
+          ((int16_t*)img->planes[c])[i] = (int16_t) v;
+      }
+    }
+  }
+
+  return 0;
+}
+
+static void image_free(bench_image *img) {
+  for (int c = 0; c < 3; c++)
+    free(img->planes[c]);
+}
+
+/* sets `heights` and `planes` to the stripe that starts at luma row `y` */
+static void get_stripe(const bench_config *cfg, const bench_image *img, int y,
+                       int *heights, void **planes) {
+  int stripe_height = cfg->stripe_height > 0 ? cfg->stripe_height : cfg->height;
+
+  for (int c = 0; c < 3; c++) {
+    int scale = cfg->height / img->heights[c];
+    int first_row = y / scale;
+    int last_row = (y + stripe_height) / scale;
+
+    if (last_row > img->heights[c])
+      last_row = img->heights[c];
+
+    heights[c] = last_row - first_row;
+    planes[c] = (char*)img->planes[c] +
+                (size_t)first_row * img->widths[c] * img->sample_size;
+  }
+}
+
+static int encode(const bench_config *cfg, const bench_image *img,
+                  kdu_stripe_compressor *enc, mem_compressed_target *target) {
+  kdu_siz_params *siz = NULL;
+  kdu_codestream *cs = NULL;
+  int precisions[3] = {cfg->depth, cfg->depth, cfg->depth};
+  bool is_signed[3] = {false, false, false};
+  int ret;
+
+  ret = kdu_siz_params_new(&siz);
+  if (ret)
+    return ret;
+
+  kdu_siz_params_set_num_components(siz, 3);
+  kdu_siz_params_set_precision(siz, 0, cfg->depth);
+  kdu_siz_params_set_signed(siz, 0, 0);
+  for (int c = 0; c < 3; c++)
+    kdu_siz_params_set_size(siz, c, img->heights[c], img->widths[c]);
+
+  ret = kdu_codestream_create_from_target(target, siz, &cs);
+  if (ret)
+    return ret;
+
+  kdu_stripe_compressor_options opts;
+
+  kdu_stripe_compressor_options_init(&opts);
+
+  opts.thread_count = cfg->thread_count;
+  opts.block_coder = cfg->block_coder;
+
+  ret = kdu_stripe_compressor_start(enc, cs, &opts);
+  if (ret)
+    return ret;
+
+  for (int y = 0, stop = 0; !stop; y += cfg->stripe_height) {
+    int heights[3];
+    void *planes[3];
+
+    get_stripe(cfg, img, y, heights, planes);
+
+    if (img->sample_size == 1)
+      stop = kdu_stripe_compressor_push_stripe_planar(
+          enc, (unsigned char**)planes, heights, NULL, NULL, precisions);
+    else
+      stop = kdu_stripe_compressor_push_stripe_planar_16(
+          enc, (int16_t**)planes, heights, NULL, NULL, precisions, is_signed);
+  }
+
+  ret = kdu_stripe_compressor_finish(enc);
+
+  kdu_codestream_delete(cs);
+
+  kdu_siz_params_delete(siz);
+
+  return ret;
+}
+
+static int decode(const bench_config *cfg, const bench_image *img,
+                  kdu_stripe_decompressor *dec, unsigned char *buf, int buf_sz) {
+  kdu_compressed_source *source = NULL;
+  kdu_codestream *cs = NULL;
+  int precisions[3] = {cfg->depth, cfg->depth, cfg->depth};
+  bool is_signed[3] = {false, false, false};
+  int ret;
+
+  ret = kdu_compressed_source_buffered_new(buf, buf_sz, &source);
+  if (ret)
+    return ret;
+
+  ret = kdu_codestream_create_from_source(source, &cs);
+  if (ret)
+    return ret;
+
+  kdu_stripe_decompressor_options opts;
+
+  kdu_stripe_decompressor_options_init(&opts);
+
+  opts.thread_count = cfg->thread_count;
+
+  ret = kdu_stripe_decompressor_start(dec, cs, &opts);
+  if (ret)
+    return ret;
+
+  for (int y = 0, stop = 0; !stop; y += cfg->stripe_height) {
+    int heights[3];
+    void *planes[3];
+
+    get_stripe(cfg, img, y, heights, planes);
+
+    if (img->sample_size == 1)
+      stop = kdu_stripe_decompressor_pull_stripe_planar(
+          dec, (unsigned char**)planes, heights, NULL, NULL, precisions, NULL);
+    else
+      stop = kdu_stripe_decompressor_pull_stripe_planar_16(
+          dec, (int16_t**)planes, heights, NULL, NULL, precisions, is_signed,
+          NULL);
+  }
+
+  ret = kdu_stripe_decompressor_finish(dec);
+
+  kdu_codestream_delete(cs);
+
+  kdu_compressed_source_buffered_delete(source);
+
+  return ret;
+}
+
+static int run(const bench_config *cfg, int frame_count,
+               bench_result *enc_result, bench_result *dec_result) {
+  bench_image img;
+  mem_compressed_target *target = NULL;
+  kdu_stripe_compressor *enc = NULL;
+  kdu_stripe_decompressor *dec = NULL;
+  unsigned char *buf;
+  int buf_sz;
+  int ret;
+
+  if (image_init(&img, cfg))
+    return 1;
+
+  ret = kdu_stripe_compressor_new(&enc);
+  if (ret)
+    return ret;
+
+  ret = kdu_stripe_decompressor_new(&dec);
+  if (ret)
+    return ret;
+
+  /* the first frame warms up caches and threads, and is not measured */
+
+  enc_result->seconds = 0;
+  enc_result->codestream_size = 0;
+  dec_result->seconds = 0;
+
+  for (int i = 0; i <= frame_count; i++) {
+    double start;
+
+    ret = kdu_compressed_target_mem_new(&target);
+    if (ret)
+      return ret;
+
+    start = now();
+
+    ret = encode(cfg, &img, enc, target);
+    if (ret)
+      return ret;
+
+    if (i > 0)
+      enc_result->seconds += now() - start;
+
+    kdu_compressed_target_bytes(target, &buf, &buf_sz);
+
+    if (i > 0)
+      enc_result->codestream_size += buf_sz;
+
+    start = now();
+
+    ret = decode(cfg, &img, dec, buf, buf_sz);
+    if (ret)
+      return ret;
+
+    if (i > 0)
+      dec_result->seconds += now() - start;
+
+    kdu_compressed_target_mem_delete(target);
+  }
+
+  dec_result->codestream_size = enc_result->codestream_size;
+
+  kdu_stripe_decompressor_delete(dec);
+
+  kdu_stripe_compressor_delete(enc);
+
+  image_free(&img);
+
+  return 0;
+}
+
+static void print_result(const char *name, const bench_config *cfg,
+                         int frame_count, const bench_result *result) {
+  double pixels = (double)cfg->width * cfg->height;
+  double samples = pixels * (cfg->is_420 ? 1.5 : 3);
+  double sample_size = cfg->depth > 8 ? 2 : 1;
+
+  printf("\"%s\": {\"frames_per_s\": %.3f, \"mpixel_per_s\": %.3f, "
+         "\"mb_per_s\": %.3f, \"bytes_per_frame\": %.0f}",
+         name,
+         frame_count / result->seconds,
+         frame_count * pixels / result->seconds / 1e6,
+         frame_count * samples * sample_size / result->seconds / 1e6,
+         (double)result->codestream_size / frame_count);
+}
+
+int main(int argc, char *argv[]) {
+  static const int sizes[][2] = {{640, 360}, {1920, 1080}, {3840, 2160}};
+  static const int depths[] = {8, 12, 16};
+  static const int stripe_heights[] = {16, 128, 0};
+  static const kdu_block_coder block_coders[] = {KDU_BLOCK_CODER_LEGACY,
+                                                 KDU_BLOCK_CODER_HT};
+  int frame_count = 5;
+  int max_thread_count = 4;
+  int size_count = 3;
+  int is_first = 1;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+      frame_count = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+      max_thread_count = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--quick") == 0) {
+      size_count = 1;
+    } else {
+      fprintf(stderr,
+              "usage: %s [--frames <count>] [--threads <max count>] [--quick]\n",
+              argv[0]);
+      return 1;
+    }
+  }
+
+  if (frame_count < 1 || max_thread_count < 1)
+    return 1;
+
+  kdu_register_error_handler(&exit_with_error);
+
+  printf("[\n");
+
+  for (int s = 0; s < size_count; s++)
+  for (int l = 0; l < 2; l++)
+  for (int d = 0; d < 3; d++)
+  for (int h = 0; h < 3; h++)
+  for (int t = 1; t <= max_thread_count; t *= 2)
+  for (int b = 0; b < 2; b++) {
+    bench_config cfg;
+    bench_result enc_result;
+    bench_result dec_result;
+
+    cfg.width = sizes[s][0];
+    cfg.height = sizes[s][1];
+    cfg.is_420 = l == 1;
+    cfg.depth = depths[d];
+    cfg.stripe_height = stripe_heights[h];
+    cfg.thread_count = t;
+    cfg.block_coder = block_coders[b];
+
+    if (run(&cfg, frame_count, &enc_result, &dec_result)) {
+      fprintf(stderr, "benchmark failed\n");
+      return 1;
+    }
+
+    printf("%s  {\"width\": %d, \"height\": %d, \"layout\": \"%s\", "
+           "\"depth\": %d, \"stripe_height\": %d, \"threads\": %d, "
+           "\"block_coder\": \"%s\", ",
+           is_first ? "" : ",\n",
+           cfg.width, cfg.height, cfg.is_420 ? "4:2:0" : "4:4:4", cfg.depth,
+           cfg.stripe_height > 0 ? cfg.stripe_height : cfg.height,
+           cfg.thread_count, cfg.block_coder == KDU_BLOCK_CODER_HT ? "ht" : "legacy");
+    print_result("encode", &cfg, frame_count, &enc_result);
+    printf(", ");
+    print_result("decode", &cfg, frame_count, &dec_result);
+    printf("}");
+    fflush(stdout);
+
+    is_first = 0;
+  }
+
+  printf("\n]\n");
+
+  return 0;
+}
@@ -25,8 +25,22 @@
  */
 
 #include "kduc.h"
+#include <ctime>
+#include <deque>
+#include <string>
 #include <vector>
 
+#ifdef KDUC_USE_SDT
+#include <sys/sdt.h>
+#endif
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 /**
  * Message handlers
  */
@@ -106,6 +120,310 @@ void kdu_register_debug_handler(kdu_message_handler_func handler) {
   debug_handler.set_handler(handler);
 }
 
+/**
+ *  kduc_thread_pool
+ */
+
+kdu_core::kdu_thread_env* kduc_threads::acquire(int thread_count,
+                                               kduc_thread_pool* pool) {
+  this->release();
+
+  if (pool) {
+    pool->borrow(&this->queue);
+
+    this->pool = pool;
+
+    return &pool->env;
+  }
+
+  if (thread_count < 2) {
+    if (this->env.exists())
+      this->env.destroy();
+    this->thread_count = 0;
+    return NULL;
+  }
+
+  if (this->env.exists() && this->thread_count == thread_count)
+    return &this->env;
+
+  if (this->env.exists())
+    this->env.destroy();
+
+  this->env.create();
+
+  for (int i = 1; i < thread_count; i++) {
+    if (!this->env.add_thread())
+      break;
+  }
+
+  this->thread_count = thread_count;
+
+  return &this->env;
+}
+
+void kduc_threads::release() {
+  if (!this->pool)
+    return;
+
+  this->pool->give_back(&this->queue);
+
+  this->pool = NULL;
+}
+
+void kduc_threads::abort(kdu_core::kdu_exception e) {
+  kdu_core::kdu_thread_env* env = this->pool ? &this->pool->env : &this->env;
+
+  if (env->exists())
+    env->handle_exception(e);
+
+  this->release();
+}
+
+void kduc_thread_pool::borrow(kdu_core::kdu_thread_queue* queue) {
+  this->mutex.lock();
+
+  while (this->borrower_count > 0 && !this->owner.check_self()) {
+    this->returned.reset();
+    this->returned.wait(this->mutex);
+  }
+
+  if (this->borrower_count == 0 && !this->owner.check_self()) {
+    this->env.change_group_owner_thread();
+    this->owner.set_to_self();
+  }
+
+  this->borrower_count++;
+
+  this->mutex.unlock();
+
+  try {
+    this->env.attach_queue(queue, NULL, "kduc");
+  } catch (...) {
+    this->give_back(NULL);
+    throw;
+  }
+}
+
+void kduc_thread_pool::give_back(kdu_core::kdu_thread_queue* queue) {
+  if (queue) {
+    try {
+      this->env.join(queue);
+    } catch (kdu_core::kdu_exception& e) {
+      this->env.handle_exception(e);
+    }
+  }
+
+  this->mutex.lock();
+
+  if (--this->borrower_count == 0)
+    this->returned.set();
+
+  this->mutex.unlock();
+}
+
+int kduc_thread_pool_new(int thread_count, kduc_thread_pool** out) {
+  kduc_thread_pool* pool = NULL;
+
+  try {
+    pool = new kduc_thread_pool();
+
+    pool->env.create();
+
+    for (int i = 1; i < thread_count; i++) {
+      if (!pool->env.add_thread())
+        break;
+    }
+  } catch (...) {
+    delete pool;
+    return 1;
+  }
+
+  *out = pool;
+
+  return 0;
+}
+
+void kduc_thread_pool_delete(kduc_thread_pool* pool) {
+  delete pool;
+}
+
+/**
+ *  tracing
+ */
+
+static kduc_trace_func trace_handler = NULL;
+
+static void* trace_user = NULL;
+
+void kduc_register_trace_handler(kduc_trace_func handler, void* user) {
+  trace_user = user;
+  trace_handler = handler;
+}
+
+/* reports the beginning and the end of `event` over its lifetime */
+class trace_scope {
+ public:
+  trace_scope(kduc_trace_event event, uint64_t frame_id)
+      : event(event), frame_id(frame_id) {
+#ifdef KDUC_USE_SDT
+    DTRACE_PROBE2(kduc, begin, (int)event, frame_id);
+#endif
+    if (trace_handler)
+      trace_handler(trace_user, event, true, frame_id);
+  }
+
+  ~trace_scope() {
+#ifdef KDUC_USE_SDT
+    DTRACE_PROBE2(kduc, end, (int)this->event, this->frame_id);
+#endif
+    if (trace_handler)
+      trace_handler(trace_user, this->event, false, this->frame_id);
+  }
+
+ private:
+  kduc_trace_event event;
+  uint64_t frame_id;
+};
+
+/**
+ *  stats
+ */
+
+static int64_t get_wall_ns() {
+#ifndef _WIN32
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#else
+  /* clock() measures wall time on Windows */
+  return (int64_t)clock() * (1000000000 / CLOCKS_PER_SEC);
+#endif
+}
+
+static int64_t get_cpu_ns() {
+#ifndef _WIN32
+  struct timespec ts;
+
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+
+  return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#else
+  return 0;
+#endif
+}
+
+/* adds the wall and CPU times of its lifetime to `wall_ns` and `cpu_ns`, and
+   reads no clock unless `is_enabled` */
+class stats_timer {
+ public:
+  stats_timer(bool is_enabled, int64_t& wall_ns, int64_t& cpu_ns)
+      : is_enabled(is_enabled), wall_ns(wall_ns), cpu_ns(cpu_ns) {
+    if (this->is_enabled) {
+      this->wall_start = get_wall_ns();
+      this->cpu_start = get_cpu_ns();
+    }
+  }
+
+  ~stats_timer() {
+    if (this->is_enabled) {
+      this->wall_ns += get_wall_ns() - this->wall_start;
+      this->cpu_ns += get_cpu_ns() - this->cpu_start;
+    }
+  }
+
+ private:
+  bool is_enabled;
+  int64_t& wall_ns;
+  int64_t& cpu_ns;
+  int64_t wall_start;
+  int64_t cpu_start;
+};
+
+/* times and traces a stripe pushed or pulled */
+class stripe_scope {
+ public:
+  explicit stripe_scope(kduc_stripe_compressor& enc)
+      : trace(KDUC_TRACE_COMPRESSOR_PUSH_STRIPE, enc.frame_id),
+        timer(enc.is_stats_enabled,
+              enc.stats.stripe_wall_ns,
+              enc.stats.stripe_cpu_ns) {
+    enc.stats.stripe_count++;
+  }
+
+  explicit stripe_scope(kduc_stripe_decompressor& dec)
+      : trace(KDUC_TRACE_DECOMPRESSOR_PULL_STRIPE, dec.frame_id),
+        timer(dec.is_stats_enabled,
+              dec.stats.stripe_wall_ns,
+              dec.stats.stripe_cpu_ns) {
+    dec.stats.stripe_count++;
+  }
+
+ private:
+  trace_scope trace;
+  stats_timer timer;
+};
+
+/**
+ *  stripe helpers
+ */
+
+static size_t get_sample_size(kduc_sample_type sample_type) {
+  switch (sample_type) {
+    case KDUC_SAMPLE_8:
+      return 1;
+    case KDUC_SAMPLE_16:
+      return 2;
+    case KDUC_SAMPLE_32:
+    case KDUC_SAMPLE_FLOAT:
+      return 4;
+  }
+
+  return 0;
+}
+
+/* stripe buffers, one per component, that are sized using the maximum
+   recommended stripe heights */
+class stripe_buffers {
+ public:
+  bool init(kdu_codestream& cs,
+            kduc_sample_type sample_type,
+            const int* max_heights) {
+    this->count = cs.get_num_components();
+
+    if (this->count > KDU_MAX_COMPONENT_COUNT)
+      return false;
+
+    for (int c = 0; c < this->count; c++) {
+      kdu_core::kdu_dims dims;
+
+      cs.get_dims(c, dims);
+
+      this->widths[c] = dims.size.x;
+      this->bufs[c].resize(std::max((size_t)1, (size_t)dims.size.x *
+                                                   max_heights[c] *
+                                                   get_sample_size(sample_type)));
+      this->planes[c] = &this->bufs[c][0];
+      this->rows[c] = 0;
+    }
+
+    return true;
+  }
+
+  int count;
+  int widths[KDU_MAX_COMPONENT_COUNT];
+  int rows[KDU_MAX_COMPONENT_COUNT];
+  void* planes[KDU_MAX_COMPONENT_COUNT];
+
+ private:
+  std::vector<kdu_core::kdu_byte> bufs[KDU_MAX_COMPONENT_COUNT];
+};
+
+static const int PREFERRED_MIN_STRIPE_HEIGHT = 8;
+
+static const int DEFAULT_MAX_STRIPE_HEIGHT = 1024;
+
 /**
  *  kdu_stripe_decompressor
  */
@@ -115,11 +433,22 @@ void kdu_stripe_decompressor_options_init(
   opts->force_precise = false;
   opts->want_fastest = false;
   opts->reduce = 0;
+  opts->region_x = 0;
+  opts->region_y = 0;
+  opts->region_width = 0;
+  opts->region_height = 0;
+  opts->region_is_reduced = false;
+  opts->max_layers = 0;
+  opts->component_count = 0;
+  opts->thread_count = 0;
+  opts->dbuf_height = -1;
+  opts->tile_concurrency = -1;
+  opts->pool = NULL;
 }
 
 int kdu_stripe_decompressor_new(kdu_stripe_decompressor** out) {
   try {
-    *out = new kdu_supp::kdu_stripe_decompressor();
+    *out = new kduc_stripe_decompressor();
   } catch (...) {
     return 1;
   }
@@ -130,11 +459,80 @@ void kdu_stripe_decompressor_delete(kdu_stripe_decompressor* dec) {
   delete dec;
 }
 
-void kdu_stripe_decompressor_start(
-    kdu_stripe_decompressor* dec,
-    kdu_codestream* cs,
+static void apply_input_restrictions(
+    kdu_codestream& cs,
     const kdu_stripe_decompressor_options* opts) {
-  dec->start(*cs, opts->force_precise, opts->want_fastest);
+  bool has_region = opts->region_width > 0 && opts->region_height > 0;
+
+  if (opts->reduce == 0 && !has_region && opts->max_layers == 0 &&
+      opts->component_count == 0)
+    return;
+
+  kdu_core::kdu_dims region;
+
+  if (has_region) {
+    kdu_core::kdu_dims image;
+    int scale = opts->region_is_reduced ? 1 << opts->reduce : 1;
+
+    /* the region is expressed on the full-resolution canvas */
+
+    cs.apply_input_restrictions(0, 0, 0, 0, NULL);
+    cs.get_dims(-1, image);
+
+    region.pos.x = image.pos.x + opts->region_x * scale;
+    region.pos.y = image.pos.y + opts->region_y * scale;
+    region.size.x = opts->region_width * scale;
+    region.size.y = opts->region_height * scale;
+
+    region &= image;
+  }
+
+  if (opts->component_count > 0) {
+    cs.apply_input_restrictions(opts->component_count,       /* num_indices */
+                                opts->components,            /* component_indices */
+                                opts->reduce,                /* discard_levels */
+                                opts->max_layers,            /* max_layers */
+                                has_region ? &region : NULL, /* region */
+                                kdu_core::KDU_WANT_CODESTREAM_COMPONENTS);
+  } else {
+    cs.apply_input_restrictions(0,                           /* first_component */
+                                0,                           /* max_components */
+                                opts->reduce,                /* discard_levels */
+                                opts->max_layers,            /* max_layers */
+                                has_region ? &region : NULL, /* region */
+                                kdu_core::KDU_WANT_OUTPUT_COMPONENTS);
+  }
+}
+
+int kdu_stripe_decompressor_start(kdu_stripe_decompressor* dec,
+                                  kdu_codestream* cs,
+                                  const kdu_stripe_decompressor_options* opts) {
+  trace_scope trace(KDUC_TRACE_DECOMPRESSOR_START, dec->frame_id);
+  stats_timer timer(dec->is_stats_enabled, dec->stats.start_wall_ns,
+                    dec->stats.start_cpu_ns);
+  kdu_core::kdu_thread_env* env = NULL;
+
+  try {
+    apply_input_restrictions(*cs, opts);
+
+    env = dec->threads.acquire(opts->thread_count, opts->pool);
+
+    dec->start(*cs,                      /* codestream */
+               opts->force_precise,      /* force_precise */
+               opts->want_fastest,       /* want_fastest */
+               env,                      /* env */
+               dec->threads.get_queue(), /* env_queue */
+               opts->dbuf_height,        /* env_dbuf_height */
+               opts->tile_concurrency    /* env_tile_concurrency */
+    );
+  } catch (kdu_core::kdu_exception& e) {
+    if (env)
+      env->handle_exception(e);
+    dec->threads.release();
+    return 1;
+  }
+
+  return 0;
 }
 
 int kdu_stripe_decompressor_pull_stripe(kdu_stripe_decompressor* dec,
@@ -145,6 +543,8 @@ int kdu_stripe_decompressor_pull_stripe(kdu_stripe_decompressor* dec,
                                         const int* row_gaps,
                                         const int* precisions,
                                         const int* pad_flags) {
+  stripe_scope scope(*dec);
+
   return !dec->pull_stripe(pixels, stripe_heights, sample_offsets, sample_gaps,
                            row_gaps, precisions, pad_flags);
 }
@@ -156,6 +556,8 @@ int kdu_stripe_decompressor_pull_stripe_planar(kdu_stripe_decompressor* dec,
                                                const int* row_gaps,
                                                const int* precisions,
                                                const int* pad_flags) {
+  stripe_scope scope(*dec);
+
   return !dec->pull_stripe(pixels, stripe_heights, sample_gaps, row_gaps,
                            precisions, pad_flags);
 }
@@ -169,6 +571,38 @@ int kdu_stripe_decompressor_pull_stripe_16(kdu_stripe_decompressor* dec,
                                            const int* precisions,
                                            const bool* is_signed,
                                            const int* pad_flags) {
+  stripe_scope scope(*dec);
+
+  return !dec->pull_stripe(pixels, stripe_heights, sample_offsets, sample_gaps,
+                           row_gaps, precisions, is_signed, pad_flags);
+}
+
+int kdu_stripe_decompressor_pull_stripe_32(kdu_stripe_decompressor* dec,
+                                           int32_t* pixels,
+                                           const int* stripe_heights,
+                                           const int* sample_offsets,
+                                           const int* sample_gaps,
+                                           const int* row_gaps,
+                                           const int* precisions,
+                                           const bool* is_signed,
+                                           const int* pad_flags) {
+  stripe_scope scope(*dec);
+
+  return !dec->pull_stripe(pixels, stripe_heights, sample_offsets, sample_gaps,
+                           row_gaps, precisions, is_signed, pad_flags);
+}
+
+int kdu_stripe_decompressor_pull_stripe_float(kdu_stripe_decompressor* dec,
+                                              float* pixels,
+                                              const int* stripe_heights,
+                                              const int* sample_offsets,
+                                              const int* sample_gaps,
+                                              const int* row_gaps,
+                                              const int* precisions,
+                                              const bool* is_signed,
+                                              const int* pad_flags) {
+  stripe_scope scope(*dec);
+
   return !dec->pull_stripe(pixels, stripe_heights, sample_offsets, sample_gaps,
                            row_gaps, precisions, is_signed, pad_flags);
 }
@@ -181,12 +615,155 @@ int kdu_stripe_decompressor_pull_stripe_planar_16(kdu_stripe_decompressor* dec,
                                                   const int* precisions,
                                                   const bool* is_signed,
                                                   const int* pad_flags) {
+  stripe_scope scope(*dec);
+
+  return !dec->pull_stripe(pixels, stripe_heights, sample_gaps, row_gaps,
+                           precisions, is_signed, pad_flags);
+}
+
+int kdu_stripe_decompressor_pull_stripe_planar_32(kdu_stripe_decompressor* dec,
+                                                  int32_t** pixels,
+                                                  const int* stripe_heights,
+                                                  const int* sample_gaps,
+                                                  const int* row_gaps,
+                                                  const int* precisions,
+                                                  const bool* is_signed,
+                                                  const int* pad_flags) {
+  stripe_scope scope(*dec);
+
+  return !dec->pull_stripe(pixels, stripe_heights, sample_gaps, row_gaps,
+                           precisions, is_signed, pad_flags);
+}
+
+int kdu_stripe_decompressor_pull_stripe_planar_float(kdu_stripe_decompressor* dec,
+                                                     float** pixels,
+                                                     const int* stripe_heights,
+                                                     const int* sample_gaps,
+                                                     const int* row_gaps,
+                                                     const int* precisions,
+                                                     const bool* is_signed,
+                                                     const int* pad_flags) {
+  stripe_scope scope(*dec);
+
   return !dec->pull_stripe(pixels, stripe_heights, sample_gaps, row_gaps,
                            precisions, is_signed, pad_flags);
 }
 
+static bool pull_planes(kduc_stripe_decompressor& dec,
+                        kduc_sample_type sample_type,
+                        void* const* planes,
+                        const int* heights,
+                        const int* row_gaps,
+                        const int* precisions,
+                        const bool* is_signed) {
+  stripe_scope scope(dec);
+
+  switch (sample_type) {
+    case KDUC_SAMPLE_8:
+      return dec.pull_stripe((kdu_core::kdu_byte**)planes, heights, NULL,
+                             row_gaps, precisions);
+    case KDUC_SAMPLE_16:
+      return dec.pull_stripe((kdu_core::kdu_int16**)planes, heights, NULL,
+                             row_gaps, precisions, is_signed);
+    case KDUC_SAMPLE_32:
+      return dec.pull_stripe((kdu_core::kdu_int32**)planes, heights, NULL,
+                             row_gaps, precisions, is_signed);
+    case KDUC_SAMPLE_FLOAT:
+      return dec.pull_stripe((float**)planes, heights, NULL, row_gaps,
+                             precisions, is_signed);
+  }
+
+  return false;
+}
+
+bool kdu_stripe_decompressor_get_recommended_stripe_heights(
+    kdu_stripe_decompressor* dec,
+    int preferred_min_height,
+    int absolute_max_height,
+    int* stripe_heights,
+    int* max_stripe_heights) {
+  return dec->get_recommended_stripe_heights(preferred_min_height,
+                                             absolute_max_height,
+                                             stripe_heights,
+                                             max_stripe_heights);
+}
+
+int kdu_stripe_decompressor_pull_rows(kdu_stripe_decompressor* dec,
+                                      kdu_codestream* cs,
+                                      kduc_sample_type sample_type,
+                                      const int* precisions,
+                                      const bool* is_signed,
+                                      int max_stripe_height,
+                                      kduc_row_writer_func writer,
+                                      void* user) {
+  int heights[KDU_MAX_COMPONENT_COUNT];
+  int max_heights[KDU_MAX_COMPONENT_COUNT];
+  int max_height = max_stripe_height > 0 ? max_stripe_height
+                                         : DEFAULT_MAX_STRIPE_HEIGHT;
+  stripe_buffers stripes;
+
+  try {
+    dec->get_recommended_stripe_heights(PREFERRED_MIN_STRIPE_HEIGHT, max_height,
+                                        heights, max_heights);
+
+    if (!stripes.init(*cs, sample_type, max_heights))
+      return 1;
+
+    for (bool is_more = true; is_more;) {
+      dec->get_recommended_stripe_heights(PREFERRED_MIN_STRIPE_HEIGHT,
+                                          max_height, heights, NULL);
+
+      is_more = pull_planes(*dec, sample_type, stripes.planes, heights, NULL,
+                            precisions, is_signed);
+
+      for (int c = 0; c < stripes.count; c++) {
+        if (heights[c] > 0 && writer(user, c, stripes.rows[c], heights[c],
+                                     stripes.widths[c], stripes.planes[c]))
+          return 1;
+
+        stripes.rows[c] += heights[c];
+      }
+    }
+  } catch (kdu_core::kdu_exception& e) {
+    dec->threads.abort(e);
+    return 1;
+  } catch (...) {
+    /* std::bad_alloc from the stripe buffers */
+    dec->threads.abort(KDU_MEMORY_EXCEPTION);
+    return 1;
+  }
+
+  return 0;
+}
+
+void kdu_stripe_decompressor_set_frame_id(kdu_stripe_decompressor* dec,
+                                          uint64_t frame_id) {
+  dec->frame_id = frame_id;
+}
+
+void kdu_stripe_decompressor_enable_stats(kdu_stripe_decompressor* dec,
+                                          bool enable) {
+  dec->is_stats_enabled = enable;
+}
+
+void kdu_stripe_decompressor_get_stats(kdu_stripe_decompressor* dec,
+                                       kduc_stripe_stats* stats) {
+  *stats = dec->stats;
+}
+
+void kdu_stripe_decompressor_reset_stats(kdu_stripe_decompressor* dec) {
+  memset(&dec->stats, 0, sizeof(dec->stats));
+}
+
 int kdu_stripe_decompressor_finish(kdu_stripe_decompressor* dec) {
-  return !dec->finish();
+  trace_scope trace(KDUC_TRACE_DECOMPRESSOR_FINISH, dec->frame_id);
+  stats_timer timer(dec->is_stats_enabled, dec->stats.finish_wall_ns,
+                    dec->stats.finish_cpu_ns);
+  bool is_done = dec->finish();
+
+  dec->threads.release();
+
+  return !is_done;
 }
 
 /**
@@ -199,11 +776,18 @@ void kdu_stripe_compressor_options_init(kdu_stripe_compressor_options* opts) {
   opts->rate_count = 0;
   opts->slope_count = 0;
   opts->tolerance = 0;
+  opts->thread_count = 0;
+  opts->dbuf_height = -1;
+  opts->tile_concurrency = -1;
+  opts->pool = NULL;
+  opts->block_coder = KDU_BLOCK_CODER_DEFAULT;
+  opts->gen_tlm = 0;
+  opts->gen_plt = false;
 }
 
 int kdu_stripe_compressor_new(kdu_stripe_compressor** enc) {
   try {
-    *enc = new kdu_supp::kdu_stripe_compressor();
+    *enc = new kduc_stripe_compressor();
   } catch (...) {
     return 1;
   }
@@ -232,9 +816,44 @@ static kdu_core::kdu_long get_total_pels(kdu_codestream& codestream) {
   return ((kdu_core::kdu_long)max_height) * ((kdu_core::kdu_long)max_width);
 }
 
+static void set_block_coder(kdu_codestream& cs, kdu_block_coder block_coder) {
+  if (block_coder == KDU_BLOCK_CODER_DEFAULT)
+    return;
+
+  kdu_core::kdu_params* cod = cs.access_siz()->access_cluster(COD_params);
+  int modes = 0;
+
+  cod->get(Cmodes, 0, 0, modes);
+
+  modes &= ~(Cmodes_HT | Cmodes_HTMIX);
+
+  if (block_coder == KDU_BLOCK_CODER_HT)
+    modes |= Cmodes_HT;
+  else if (block_coder == KDU_BLOCK_CODER_HT_MIXED)
+    modes |= Cmodes_HT | Cmodes_HTMIX;
+
+  cod->set(Cmodes, 0, 0, modes);
+}
+
+/* the TLM and PLT markers are rewritten by the target once the codestream is
+   flushed */
+static void set_index_markers(kdu_codestream& cs,
+                              const kdu_stripe_compressor_options* opts) {
+  kdu_core::kdu_params* org = cs.access_siz()->access_cluster(ORG_params);
+
+  if (opts->gen_tlm > 0)
+    org->set(ORGgen_tlm, 0, 0, opts->gen_tlm);
+
+  if (opts->gen_plt)
+    org->set(ORGgen_plt, 0, 0, true);
+}
+
 int kdu_stripe_compressor_start(kdu_stripe_compressor* enc,
                                 kdu_codestream* cs,
                                 const kdu_stripe_compressor_options* opts) {
+  trace_scope trace(KDUC_TRACE_COMPRESSOR_START, enc->frame_id);
+  stats_timer timer(enc->is_stats_enabled, enc->stats.start_wall_ns,
+                    enc->stats.start_cpu_ns);
   kdu_core::kdu_uint16 slope[KDU_MAX_LAYER_COUNT];
   kdu_core::kdu_long size[KDU_MAX_LAYER_COUNT];
   int layer_count;
@@ -258,7 +877,15 @@ int kdu_stripe_compressor_start(kdu_stripe_compressor* enc,
 
   layer_count = opts->rate_count ? opts->rate_count : opts->slope_count;
 
+  kdu_core::kdu_thread_env* env = NULL;
+
   try {
+    env = enc->threads.acquire(opts->thread_count, opts->pool);
+
+    set_block_coder(*cs, opts->block_coder);
+
+    set_index_markers(*cs, opts);
+
     cs->access_siz()->finalize_all();
 
     cs->set_textualization(&info_handler);
@@ -273,13 +900,17 @@ int kdu_stripe_compressor_start(kdu_stripe_compressor* enc,
                true,                     /* record_layer_info_in_comment */
                opts->tolerance,          /* size_tolerance */
                0,                        /* num_components */
-               opts->want_fastest, NULL, /*env*/
-               NULL,                     /* env_queue */
-               -1,                       /* env_dbuf_height */
-               -1,                       /* env_tile_concurrency */
+               opts->want_fastest,       /* want_fastest */
+               env,                      /* env */
+               enc->threads.get_queue(), /* env_queue */
+               opts->dbuf_height,        /* env_dbuf_height */
+               opts->tile_concurrency,   /* env_tile_concurrency */
                opts->tolerance == 0,     /* trim_to_rate */
                KDU_FLUSH_USES_THRESHOLDS_AND_SIZES);
   } catch (kdu_core::kdu_exception& e) {
+    if (env)
+      env->handle_exception(e);
+    enc->threads.release();
     return 1;
   }
 
@@ -293,6 +924,8 @@ int kdu_stripe_compressor_push_stripe(kdu_stripe_compressor* enc,
                                       const int* sample_gaps,
                                       const int* row_gaps,
                                       const int* precisions) {
+  stripe_scope scope(*enc);
+
   return !enc->push_stripe(pixels,         /* buffer */
                            stripe_heights, /* stripe_heights */
                            sample_offsets, /* sample_offsets */
@@ -310,6 +943,8 @@ int kdu_stripe_compressor_push_stripe_16(kdu_stripe_compressor* enc,
                                          const int* row_gaps,
                                          const int* precisions,
                                          const bool* is_signed) {
+  stripe_scope scope(*enc);
+
   return !enc->push_stripe(pixels,         /* buffer */
                            stripe_heights, /* stripe_heights */
                            sample_offsets, /* sample_offsets */
@@ -320,27 +955,107 @@ int kdu_stripe_compressor_push_stripe_16(kdu_stripe_compressor* enc,
   );
 }
 
-int kdu_stripe_compressor_push_stripe_planar(kdu_stripe_compressor* enc,
-                                             unsigned char* pixels[],
-                                             const int* stripe_heights,
-                                             const int* sample_gaps,
-                                             const int* row_gaps,
-                                             const int* precisions) {
+int kdu_stripe_compressor_push_stripe_32(kdu_stripe_compressor* enc,
+                                         int32_t* pixels,
+                                         const int* stripe_heights,
+                                         const int* sample_offsets,
+                                         const int* sample_gaps,
+                                         const int* row_gaps,
+                                         const int* precisions,
+                                         const bool* is_signed) {
+  stripe_scope scope(*enc);
+
   return !enc->push_stripe(pixels,         /* buffer */
                            stripe_heights, /* stripe_heights */
+                           sample_offsets, /* sample_offsets */
                            sample_gaps,    /* sample_gaps */
                            row_gaps,       /* row_gaps */
-                           precisions      /* precisions*/
+                           precisions,     /* precisions*/
+                           is_signed       /* is_signed*/
   );
 }
 
-int kdu_stripe_compressor_push_stripe_planar_16(kdu_stripe_compressor* enc,
+int kdu_stripe_compressor_push_stripe_float(kdu_stripe_compressor* enc,
+                                            float* pixels,
+                                            const int* stripe_heights,
+                                            const int* sample_offsets,
+                                            const int* sample_gaps,
+                                            const int* row_gaps,
+                                            const int* precisions,
+                                            const bool* is_signed) {
+  stripe_scope scope(*enc);
+
+  return !enc->push_stripe(pixels,         /* buffer */
+                           stripe_heights, /* stripe_heights */
+                           sample_offsets, /* sample_offsets */
+                           sample_gaps,    /* sample_gaps */
+                           row_gaps,       /* row_gaps */
+                           precisions,     /* precisions*/
+                           is_signed       /* is_signed*/
+  );
+}
+
+int kdu_stripe_compressor_push_stripe_planar(kdu_stripe_compressor* enc,
+                                             unsigned char* pixels[],
+                                             const int* stripe_heights,
+                                             const int* sample_gaps,
+                                             const int* row_gaps,
+                                             const int* precisions) {
+  stripe_scope scope(*enc);
+
+  return !enc->push_stripe(pixels,         /* buffer */
+                           stripe_heights, /* stripe_heights */
+                           sample_gaps,    /* sample_gaps */
+                           row_gaps,       /* row_gaps */
+                           precisions      /* precisions*/
+  );
+}
+
+int kdu_stripe_compressor_push_stripe_planar_16(kdu_stripe_compressor* enc,
                                                 int16_t* pixels[],
                                                 const int* stripe_heights,
                                                 const int* sample_gaps,
                                                 const int* row_gaps,
                                                 const int* precisions,
                                                 const bool* is_signed) {
+  stripe_scope scope(*enc);
+
+  return !enc->push_stripe(pixels,         /* buffer */
+                           stripe_heights, /* stripe_heights */
+                           sample_gaps,    /* sample_gaps */
+                           row_gaps,       /* row_gaps */
+                           precisions,     /* precisions*/
+                           is_signed       /* is_signed*/
+  );
+}
+
+int kdu_stripe_compressor_push_stripe_planar_32(kdu_stripe_compressor* enc,
+                                                int32_t* pixels[],
+                                                const int* stripe_heights,
+                                                const int* sample_gaps,
+                                                const int* row_gaps,
+                                                const int* precisions,
+                                                const bool* is_signed) {
+  stripe_scope scope(*enc);
+
+  return !enc->push_stripe(pixels,         /* buffer */
+                           stripe_heights, /* stripe_heights */
+                           sample_gaps,    /* sample_gaps */
+                           row_gaps,       /* row_gaps */
+                           precisions,     /* precisions*/
+                           is_signed       /* is_signed*/
+  );
+}
+
+int kdu_stripe_compressor_push_stripe_planar_float(kdu_stripe_compressor* enc,
+                                                   float* pixels[],
+                                                   const int* stripe_heights,
+                                                   const int* sample_gaps,
+                                                   const int* row_gaps,
+                                                   const int* precisions,
+                                                   const bool* is_signed) {
+  stripe_scope scope(*enc);
+
   return !enc->push_stripe(pixels,         /* buffer */
                            stripe_heights, /* stripe_heights */
                            sample_gaps,    /* sample_gaps */
@@ -350,116 +1065,1287 @@ int kdu_stripe_compressor_push_stripe_planar_16(kdu_stripe_compressor* enc,
   );
 }
 
-int kdu_stripe_compressor_finish(kdu_stripe_compressor* enc) {
-  return !enc->finish();
-}
+static bool push_planes(kduc_stripe_compressor& enc,
+                        kduc_sample_type sample_type,
+                        void* const* planes,
+                        const int* heights,
+                        const int* row_gaps,
+                        const int* precisions,
+                        const bool* is_signed) {
+  stripe_scope scope(enc);
+
+  switch (sample_type) {
+    case KDUC_SAMPLE_8:
+      return enc.push_stripe((kdu_core::kdu_byte**)planes, heights, NULL,
+                             row_gaps, precisions);
+    case KDUC_SAMPLE_16:
+      return enc.push_stripe((kdu_core::kdu_int16**)planes, heights, NULL,
+                             row_gaps, precisions, is_signed);
+    case KDUC_SAMPLE_32:
+      return enc.push_stripe((kdu_core::kdu_int32**)planes, heights, NULL,
+                             row_gaps, precisions, is_signed);
+    case KDUC_SAMPLE_FLOAT:
+      return enc.push_stripe((float**)planes, heights, NULL, row_gaps,
+                             precisions, is_signed);
+  }
+
+  return false;
+}
+
+bool kdu_stripe_compressor_get_recommended_stripe_heights(
+    kdu_stripe_compressor* enc,
+    int preferred_min_height,
+    int absolute_max_height,
+    int* stripe_heights,
+    int* max_stripe_heights) {
+  return enc->get_recommended_stripe_heights(preferred_min_height,
+                                             absolute_max_height,
+                                             stripe_heights,
+                                             max_stripe_heights);
+}
+
+int kdu_stripe_compressor_push_rows(kdu_stripe_compressor* enc,
+                                    kdu_codestream* cs,
+                                    kduc_sample_type sample_type,
+                                    const int* precisions,
+                                    const bool* is_signed,
+                                    int max_stripe_height,
+                                    kduc_row_reader_func reader,
+                                    void* user) {
+  int heights[KDU_MAX_COMPONENT_COUNT];
+  int max_heights[KDU_MAX_COMPONENT_COUNT];
+  int max_height = max_stripe_height > 0 ? max_stripe_height
+                                         : DEFAULT_MAX_STRIPE_HEIGHT;
+  stripe_buffers stripes;
+
+  try {
+    enc->get_recommended_stripe_heights(PREFERRED_MIN_STRIPE_HEIGHT, max_height,
+                                        heights, max_heights);
+
+    if (!stripes.init(*cs, sample_type, max_heights))
+      return 1;
+
+    for (bool is_more = true; is_more;) {
+      enc->get_recommended_stripe_heights(PREFERRED_MIN_STRIPE_HEIGHT,
+                                          max_height, heights, NULL);
+
+      for (int c = 0; c < stripes.count; c++) {
+        if (heights[c] > 0 && reader(user, c, stripes.rows[c], heights[c],
+                                     stripes.widths[c], stripes.planes[c]))
+          return 1;
+
+        stripes.rows[c] += heights[c];
+      }
+
+      is_more = push_planes(*enc, sample_type, stripes.planes, heights, NULL,
+                            precisions, is_signed);
+    }
+  } catch (kdu_core::kdu_exception& e) {
+    enc->threads.abort(e);
+    return 1;
+  } catch (...) {
+    /* std::bad_alloc from the stripe buffers */
+    enc->threads.abort(KDU_MEMORY_EXCEPTION);
+    return 1;
+  }
+
+  return 0;
+}
+
+void kdu_stripe_compressor_set_frame_id(kdu_stripe_compressor* enc,
+                                        uint64_t frame_id) {
+  enc->frame_id = frame_id;
+}
+
+void kdu_stripe_compressor_enable_stats(kdu_stripe_compressor* enc,
+                                        bool enable) {
+  enc->is_stats_enabled = enable;
+}
+
+void kdu_stripe_compressor_get_stats(kdu_stripe_compressor* enc,
+                                     kduc_stripe_stats* stats) {
+  *stats = enc->stats;
+}
+
+void kdu_stripe_compressor_reset_stats(kdu_stripe_compressor* enc) {
+  memset(&enc->stats, 0, sizeof(enc->stats));
+}
+
+int kdu_stripe_compressor_finish(kdu_stripe_compressor* enc) {
+  trace_scope trace(KDUC_TRACE_COMPRESSOR_FINISH, enc->frame_id);
+  stats_timer timer(enc->is_stats_enabled, enc->stats.finish_wall_ns,
+                    enc->stats.finish_cpu_ns);
+  bool is_done = enc->finish();
+
+  enc->threads.release();
+
+  return !is_done;
+}
+
+/**
+ *  kduc_sequence_encoder
+ */
+
+class kduc_sequence_encoder {
+ public:
+  kduc_sequence_encoder() : siz(NULL) {}
+
+  ~kduc_sequence_encoder() {
+    if (this->cs.exists())
+      this->cs.destroy();
+  }
+
+  kdu_siz_params* siz;
+  std::vector<std::string> params;
+  kdu_stripe_compressor_options opts;
+  kduc_stripe_compressor enc;
+  kdu_supp::kdu_codestream cs;
+};
+
+int kduc_sequence_encoder_new(kdu_siz_params* sz,
+                              const char* const* params,
+                              int param_count,
+                              const kdu_stripe_compressor_options* opts,
+                              kduc_sequence_encoder** out) {
+  try {
+    *out = new kduc_sequence_encoder();
+
+    (*out)->siz = sz;
+    (*out)->params.assign(params, params + param_count);
+    (*out)->opts = *opts;
+  } catch (...) {
+    return 1;
+  }
+
+  return 0;
+}
+
+void kduc_sequence_encoder_delete(kduc_sequence_encoder* seq) {
+  delete seq;
+}
+
+int kduc_sequence_encoder_start(kduc_sequence_encoder* seq,
+                                mem_compressed_target* target,
+                                kdu_stripe_compressor** enc) {
+  bool is_ok = true;
+
+  try {
+    if (seq->cs.exists()) {
+      seq->cs.restart(target);
+    } else {
+      static_cast<kdu_core::kdu_params*>(seq->siz)->finalize();
+
+      seq->cs.create(seq->siz, target);
+
+      for (size_t i = 0; is_ok && i < seq->params.size(); i++)
+        is_ok = seq->cs.access_siz()->parse_string(seq->params[i].c_str());
+    }
+  } catch (...) {
+    is_ok = false;
+  }
+
+  /* a codestream without the caller's params must not be restarted by the
+     next frame */
+
+  if (!is_ok) {
+    if (seq->cs.exists())
+      seq->cs.destroy();
+    return 1;
+  }
+
+  if (kdu_stripe_compressor_start(&seq->enc, &seq->cs, &seq->opts))
+    return 1;
+
+  *enc = &seq->enc;
+
+  return 0;
+}
+
+int kduc_sequence_encoder_finish(kduc_sequence_encoder* seq) {
+  return kdu_stripe_compressor_finish(&seq->enc);
+}
+
+/**
+ *  kduc_sequence_decoder
+ */
+
+class kduc_sequence_decoder {
+ public:
+  ~kduc_sequence_decoder() {
+    if (this->cs.exists())
+      this->cs.destroy();
+  }
+
+  kdu_stripe_decompressor_options opts;
+  mem_compressed_source source;
+  kduc_stripe_decompressor dec;
+  kdu_supp::kdu_codestream cs;
+};
+
+int kduc_sequence_decoder_new(const kdu_stripe_decompressor_options* opts,
+                              kduc_sequence_decoder** out) {
+  try {
+    *out = new kduc_sequence_decoder();
+
+    (*out)->opts = *opts;
+  } catch (...) {
+    return 1;
+  }
+
+  return 0;
+}
+
+void kduc_sequence_decoder_delete(kduc_sequence_decoder* seq) {
+  delete seq;
+}
+
+int kduc_sequence_decoder_start(kduc_sequence_decoder* seq,
+                                const unsigned char* data,
+                                unsigned long int len,
+                                kdu_codestream** cs,
+                                kdu_stripe_decompressor** dec) {
+  seq->source.reset(data, len);
+
+  try {
+    if (seq->cs.exists())
+      seq->cs.restart(&seq->source);
+    else
+      seq->cs.create(&seq->source);
+  } catch (...) {
+    /* the codestream is left in an indeterminate state, and the next frame
+       therefore creates a new one */
+    if (seq->cs.exists())
+      seq->cs.destroy();
+    return 1;
+  }
+
+  if (kdu_stripe_decompressor_start(&seq->dec, &seq->cs, &seq->opts))
+    return 1;
+
+  *cs = &seq->cs;
+  *dec = &seq->dec;
+
+  return 0;
+}
+
+int kduc_sequence_decoder_finish(kduc_sequence_decoder* seq) {
+  return kdu_stripe_decompressor_finish(&seq->dec);
+}
+
+/**
+ *  kduc_encode_batch
+ */
+
+/* hands out the items of a batch, in order, to the threads processing it */
+class kduc_batch {
+ public:
+  explicit kduc_batch(int count) : count(count), next(0) {
+    this->mutex.create();
+  }
+
+  ~kduc_batch() { this->mutex.destroy(); }
+
+  /* returns the index of the next item, or -1 once all items are taken */
+  int take() {
+    int i = -1;
+
+    this->mutex.lock();
+    if (this->next < this->count)
+      i = this->next++;
+    this->mutex.unlock();
+
+    return i;
+  }
+
+ private:
+  int count;
+  int next;
+  kdu_core::kdu_mutex mutex;
+};
+
+/* runs `proc(param)` on `worker_count` threads, including the calling thread,
+   and returns once they have all returned */
+static void run_workers(int worker_count,
+                        kdu_core::kdu_thread_startproc proc,
+                        void* param) {
+  kdu_core::kdu_thread* threads = new kdu_core::kdu_thread[worker_count - 1];
+  int started = 0;
+
+  while (started < worker_count - 1 && threads[started].create(proc, param))
+    started++;
+
+  proc(param);
+
+  for (int i = 0; i < started; i++)
+    threads[i].destroy();
+
+  delete[] threads;
+}
+
+static int get_worker_count(int worker_count, int item_count) {
+  if (worker_count <= 0)
+    worker_count = kdu_core::kdu_get_num_processors();
+
+  return std::max(1, std::min(worker_count, item_count));
+}
+
+class encode_batch : public kduc_batch {
+ public:
+  encode_batch(kduc_encode_frame* frames, int frame_count)
+      : kduc_batch(frame_count), frames(frames) {}
+
+  kduc_encode_frame* frames;
+};
+
+static bool create_codestream(kdu_supp::kdu_codestream& cs,
+                              kduc_encode_frame* frame) {
+  trace_scope trace(KDUC_TRACE_CODESTREAM_CREATE, frame->frame_id);
+
+  try {
+    cs.create(frame->siz, frame->target);
+  } catch (...) {
+    return false;
+  }
+
+  return true;
+}
+
+static int encode_codestream(kdu_supp::kdu_codestream& cs,
+                             kduc_stripe_compressor& enc,
+                             kduc_encode_frame* frame) {
+  int heights[KDU_MAX_COMPONENT_COUNT];
+
+  for (int i = 0; i < frame->param_count; i++) {
+    if (!cs.access_siz()->parse_string(frame->params[i]))
+      return 1;
+  }
+
+  if (kdu_stripe_compressor_start(&enc, &cs, frame->opts))
+    return 1;
+
+  if (cs.get_num_components() > KDU_MAX_COMPONENT_COUNT) {
+    kdu_stripe_compressor_finish(&enc);
+    return 1;
+  }
+
+  /* the entire frame is pushed as a single stripe */
+
+  for (int c = 0; c < cs.get_num_components(); c++) {
+    kdu_core::kdu_dims dims;
+
+    cs.get_dims(c, dims);
+    heights[c] = dims.size.y;
+  }
+
+  push_planes(enc, frame->sample_type, frame->planes, heights, frame->row_gaps,
+              frame->precisions, frame->is_signed);
+
+  return kdu_stripe_compressor_finish(&enc);
+}
+
+static int encode_codestream(kdu_supp::kdu_codestream& cs,
+                             kduc_encode_frame* frame) {
+  kduc_stripe_compressor enc;
+  int ret;
+
+  enc.frame_id = frame->frame_id;
+
+  try {
+    ret = encode_codestream(cs, enc, frame);
+  } catch (kdu_core::kdu_exception& e) {
+    enc.threads.abort(e);
+    ret = 1;
+  } catch (...) {
+    enc.threads.abort(KDU_MEMORY_EXCEPTION);
+    ret = 1;
+  }
+
+  /* `enc` is finished before `cs` is destroyed, once its threads have been
+     told of any exception */
+
+  if (ret) {
+    try {
+      enc.finish();
+    } catch (...) {
+    }
+
+    enc.threads.release();
+  }
+
+  return ret;
+}
+
+/* encodes `frame` into `cs`, which was created by create_codestream(), and
+   then destroys `cs` */
+static int encode_frame(kdu_supp::kdu_codestream& cs, kduc_encode_frame* frame) {
+  int ret;
+
+  try {
+    ret = cs.exists() ? encode_codestream(cs, frame) : 1;
+  } catch (...) {
+    ret = 1;
+  }
+
+  if (cs.exists()) {
+    trace_scope trace(KDUC_TRACE_CODESTREAM_DESTROY, frame->frame_id);
+
+    cs.destroy();
+  }
+
+  return ret;
+}
+
+static kdu_core::kdu_thread_startproc_result KDU_THREAD_STARTPROC_CALL_CONVENTION
+encode_batch_worker(void* param) {
+  encode_batch* batch = (encode_batch*)param;
+
+  for (int i = batch->take(); i >= 0; i = batch->take()) {
+    kduc_encode_frame* frame = batch->frames + i;
+    kdu_supp::kdu_codestream cs;
+
+    create_codestream(cs, frame);
+
+    frame->result = encode_frame(cs, frame);
+  }
+
+  return KDU_THREAD_STARTPROC_ZERO_RESULT;
+}
+
+int kduc_encode_batch(kduc_encode_frame* frames,
+                      int frame_count,
+                      int worker_count) {
+  if (frame_count <= 0)
+    return 0;
+
+  try {
+    /* the workers only read `siz`, which may be shared by several frames */
+
+    for (int i = 0; i < frame_count; i++)
+      static_cast<kdu_core::kdu_params*>(frames[i].siz)->finalize();
+
+    encode_batch batch(frames, frame_count);
+
+    run_workers(get_worker_count(worker_count, frame_count),
+                encode_batch_worker, &batch);
+  } catch (...) {
+    return 1;
+  }
+
+  for (int i = 0; i < frame_count; i++) {
+    if (frames[i].result)
+      return 1;
+  }
+
+  return 0;
+}
+
+/**
+ *  kduc_async
+ */
+
+static int decode_frame(kdu_supp::kdu_codestream& cs,
+                        mem_compressed_source& source,
+                        kduc_stripe_decompressor& dec,
+                        kduc_decode_frame* frame) {
+  int heights[KDU_MAX_COMPONENT_COUNT];
+
+  source.reset(frame->data, frame->size);
+
+  {
+    trace_scope trace(KDUC_TRACE_CODESTREAM_CREATE, frame->frame_id);
+
+    cs.create(&source);
+  }
+
+  dec.frame_id = frame->frame_id;
+
+  if (kdu_stripe_decompressor_start(&dec, &cs, frame->opts))
+    return 1;
+
+  if (cs.get_num_components() > KDU_MAX_COMPONENT_COUNT) {
+    kdu_stripe_decompressor_finish(&dec);
+    return 1;
+  }
+
+  /* the entire frame is pulled as a single stripe */
+
+  for (int c = 0; c < cs.get_num_components(); c++) {
+    kdu_core::kdu_dims dims;
+
+    cs.get_dims(c, dims);
+    heights[c] = dims.size.y;
+  }
+
+  pull_planes(dec, frame->sample_type, frame->planes, heights, frame->row_gaps,
+              frame->precisions, frame->is_signed);
+
+  return kdu_stripe_decompressor_finish(&dec);
+}
+
+/* decodes `frame` using `dec` and `source`, which are reused across frames */
+static int decode_frame(kduc_stripe_decompressor& dec,
+                        mem_compressed_source& source,
+                        kduc_decode_frame* frame) {
+  kdu_supp::kdu_codestream cs;
+  int ret;
+
+  try {
+    ret = decode_frame(cs, source, dec, frame);
+  } catch (kdu_core::kdu_exception& e) {
+    dec.threads.abort(e);
+    ret = 1;
+  } catch (...) {
+    dec.threads.abort(KDU_MEMORY_EXCEPTION);
+    ret = 1;
+  }
+
+  /* leaves `dec` ready for the next frame, once its threads have been told of
+     any exception */
+
+  if (ret) {
+    try {
+      dec.finish();
+    } catch (...) {
+    }
+
+    dec.threads.release();
+  }
+
+  if (cs.exists()) {
+    trace_scope trace(KDUC_TRACE_CODESTREAM_DESTROY, frame->frame_id);
+
+    cs.destroy();
+  }
+
+  return ret;
+}
+
+class kduc_async {
+ public:
+  struct job {
+    kduc_encode_frame* encode;
+    kduc_decode_frame* decode;
+    void* user;
+  };
+
+  kduc_async()
+      : callback(NULL),
+        threads(NULL),
+        thread_count(0),
+        outstanding(0),
+        is_closing(false) {
+    this->mutex.create();
+    this->job_ready.create(true);
+    this->completion_ready.create(true);
+  }
+
+  ~kduc_async() {
+    this->mutex.lock();
+    this->is_closing = true;
+    this->job_ready.set();
+    this->mutex.unlock();
+
+    /* the workers exit once the queue is drained */
+
+    for (int i = 0; i < this->thread_count; i++)
+      this->threads[i].destroy();
+
+    delete[] this->threads;
+
+    this->completion_ready.destroy();
+    this->job_ready.destroy();
+    this->mutex.destroy();
+  }
+
+  bool start(int worker_count) {
+    this->threads = new kdu_core::kdu_thread[worker_count];
+
+    while (this->thread_count < worker_count &&
+           this->threads[this->thread_count].create(worker, this))
+      this->thread_count++;
+
+    return this->thread_count > 0;
+  }
+
+  void submit(const job& j) {
+    this->mutex.lock();
+
+    try {
+      if (j.encode)
+        static_cast<kdu_core::kdu_params*>(j.encode->siz)->finalize();
+
+      this->jobs.push_back(j);
+    } catch (...) {
+      this->mutex.unlock();
+      throw;
+    }
+
+    this->outstanding++;
+    this->job_ready.set();
+    this->mutex.unlock();
+  }
+
+  bool poll(bool wait, kduc_completion* completion) {
+    bool is_found = false;
+
+    this->mutex.lock();
+
+    while (wait && this->completions.empty() && this->outstanding > 0) {
+      this->completion_ready.reset();
+      this->completion_ready.wait(this->mutex);
+    }
+
+    if (!this->completions.empty()) {
+      *completion = this->completions.front();
+      this->completions.pop_front();
+      is_found = true;
+    }
+
+    this->mutex.unlock();
+
+    return is_found;
+  }
+
+  kduc_completion_func callback;
+
+ private:
+  static kdu_core::kdu_thread_startproc_result
+      KDU_THREAD_STARTPROC_CALL_CONVENTION worker(void* param) {
+    ((kduc_async*)param)->run();
+    return KDU_THREAD_STARTPROC_ZERO_RESULT;
+  }
+
+  void run() {
+    kduc_stripe_decompressor dec;
+    mem_compressed_source source;
+
+    this->mutex.lock();
+
+    for (;;) {
+      while (this->jobs.empty() && !this->is_closing) {
+        this->job_ready.reset();
+        this->job_ready.wait(this->mutex);
+      }
+
+      if (this->jobs.empty())
+        break;
+
+      job j = this->jobs.front();
+      this->jobs.pop_front();
+
+      /* `siz` may be shared with frames that are being submitted, and is
+         therefore only accessed under the lock */
+
+      kdu_supp::kdu_codestream cs;
+
+      if (j.encode)
+        create_codestream(cs, j.encode);
+
+      this->mutex.unlock();
+
+      kduc_completion completion;
+
+      completion.user = j.user;
+
+      if (j.encode)
+        completion.result = j.encode->result = encode_frame(cs, j.encode);
+      else
+        completion.result = j.decode->result = decode_frame(dec, source, j.decode);
+
+      if (this->callback)
+        this->callback(&completion);
+
+      this->mutex.lock();
+
+      if (!this->callback)
+        this->completions.push_back(completion);
+
+      this->outstanding--;
+      this->completion_ready.set();
+    }
+
+    this->mutex.unlock();
+  }
+
+  kdu_core::kdu_thread* threads;
+  int thread_count;
+  kdu_core::kdu_mutex mutex;
+  kdu_core::kdu_event job_ready;
+  kdu_core::kdu_event completion_ready;
+  std::deque<job> jobs;
+  std::deque<kduc_completion> completions;
+  int outstanding;
+  bool is_closing;
+};
+
+int kduc_async_new(int worker_count,
+                   kduc_completion_func callback,
+                   kduc_async** out) {
+  try {
+    *out = new kduc_async();
+
+    (*out)->callback = callback;
+
+    if (!(*out)->start(worker_count > 0 ? worker_count
+                                        : kdu_core::kdu_get_num_processors())) {
+      delete *out;
+      return 1;
+    }
+  } catch (...) {
+    return 1;
+  }
+
+  return 0;
+}
+
+void kduc_async_delete(kduc_async* async) {
+  delete async;
+}
+
+int kduc_async_submit_encode(kduc_async* async,
+                             kduc_encode_frame* frame,
+                             void* user) {
+  kduc_async::job j = {frame, NULL, user};
+
+  try {
+    async->submit(j);
+  } catch (...) {
+    return 1;
+  }
+
+  return 0;
+}
+
+int kduc_async_submit_decode(kduc_async* async,
+                             kduc_decode_frame* frame,
+                             void* user) {
+  kduc_async::job j = {NULL, frame, user};
+
+  try {
+    async->submit(j);
+  } catch (...) {
+    return 1;
+  }
+
+  return 0;
+}
+
+int kduc_async_poll(kduc_async* async, bool wait, kduc_completion* completion) {
+  return !async->poll(wait, completion);
+}
+
+/**
+ *  kdu_codestream
+ */
+
+int kdu_codestream_create_from_source(kdu_compressed_source* source,
+                                      kdu_codestream** cs) {
+  trace_scope trace(KDUC_TRACE_CODESTREAM_CREATE, 0);
+
+  try {
+    *cs = new kdu_supp::kdu_codestream();
+
+    (*cs)->create(source);
+  } catch (...) {
+    return 1;
+  }
+  return 0;
+}
+
+static int create_from_target(kdu_core::kdu_compressed_target* target,
+                              kdu_siz_params* sz,
+                              kdu_codestream** cs) {
+  trace_scope trace(KDUC_TRACE_CODESTREAM_CREATE, 0);
+
+  try {
+    static_cast<kdu_core::kdu_params*>(sz)->finalize();
+
+    *cs = new kdu_supp::kdu_codestream();
+
+    (*cs)->create(sz, target);
+
+  } catch (...) {
+    return 1;
+  }
+  return 0;
+}
+
+int kdu_codestream_create_from_target(mem_compressed_target* target,
+                                      kdu_siz_params* sz,
+                                      kdu_codestream** cs) {
+  return create_from_target(target, sz, cs);
+}
+
+void kdu_codestream_get_size(kdu_codestream* cs,
+                             int comp_idx,
+                             int* height,
+                             int* width) {
+  kdu_core::kdu_dims dims;
+  cs->get_dims(comp_idx, dims);
+  *height = dims.size.y;
+  *width = dims.size.x;
+}
+
+void kdu_codestream_get_subsampling(kdu_codestream* cs,
+                                    int comp_idx,
+                                    int* x,
+                                    int* y) {
+  kdu_core::kdu_coords coords;
+  cs->get_min_subsampling(comp_idx, coords);
+  *x = coords.x;
+  *y = coords.y;
+}
+
+int kdu_codestream_get_num_components(kdu_codestream* cs) {
+  return cs->get_num_components();
+}
+
+int kdu_codestream_get_depth(kdu_codestream* cs, int comp_idx) {
+  return cs->get_bit_depth(comp_idx);
+}
+
+bool kdu_codestream_get_signed(kdu_codestream* cs, int comp_idx) {
+  return cs->get_signed(comp_idx);
+}
+
+void kdu_codestream_delete(kdu_codestream* cs) {
+  trace_scope trace(KDUC_TRACE_CODESTREAM_DESTROY, 0);
+
+  cs->destroy();
+  delete cs;
+}
+
+int kdu_codestream_parse_params(kdu_codestream* cs, const char* params) {
+  if ((!cs->access_siz()->parse_string(params)))
+    return 1;
+
+  return 0;
+}
+
+void kdu_codestream_discard_levels(kdu_codestream* cs, int discard_levels) {
+  cs->apply_input_restrictions(0, 0, discard_levels, 0, NULL);
+}
+
+void kdu_codestream_textualize_params(kdu_codestream* cs,
+                                      kdu_message_handler_func handler) {
+  warning_message_handler msg_handler;
+
+  msg_handler.set_handler(handler);
+  cs->access_siz()->textualize_attributes(msg_handler, false);
+}
+
+/**
+ *  kduc_probe
+ */
+
+static uint32_t get_u16(const uint8_t* p) {
+  return ((uint32_t)p[0] << 8) | p[1];
+}
+
+static uint32_t get_u32(const uint8_t* p) {
+  return (get_u16(p) << 16) | get_u16(p + 2);
+}
+
+static uint32_t get_tile_count(uint32_t size, uint32_t tile_offset,
+                               uint32_t tile_size) {
+  return (uint32_t)(((uint64_t)size - tile_offset + tile_size - 1) / tile_size);
+}
+
+static bool parse_siz(const uint8_t* seg, uint32_t len, kduc_info* info) {
+  if (len < 36)
+    return false;
+
+  uint32_t x_size = get_u32(seg + 2);
+  uint32_t y_size = get_u32(seg + 6);
+
+  info->profile = (uint16_t)get_u16(seg);
+  info->x_offset = get_u32(seg + 10);
+  info->y_offset = get_u32(seg + 14);
+  info->tile_width = get_u32(seg + 18);
+  info->tile_height = get_u32(seg + 22);
+  info->tile_x_offset = get_u32(seg + 26);
+  info->tile_y_offset = get_u32(seg + 30);
+  info->num_components = (int)get_u16(seg + 34);
+
+  if (x_size <= info->x_offset || y_size <= info->y_offset ||
+      info->tile_width == 0 || info->tile_height == 0 ||
+      info->tile_x_offset >= x_size || info->tile_y_offset >= y_size ||
+      info->num_components == 0 || len < 36 + 3 * (uint32_t)info->num_components)
+    return false;
+
+  info->width = x_size - info->x_offset;
+  info->height = y_size - info->y_offset;
+  info->num_tiles =
+      get_tile_count(x_size, info->tile_x_offset, info->tile_width) *
+      get_tile_count(y_size, info->tile_y_offset, info->tile_height);
+
+  for (int c = 0;
+       c < std::min(info->num_components, (int)KDU_MAX_COMPONENT_COUNT); c++) {
+    const uint8_t* comp = seg + 36 + 3 * c;
+
+    info->depths[c] = (comp[0] & 0x7F) + 1;
+    info->is_signed[c] = (comp[0] & 0x80) != 0;
+    info->subsampling_x[c] = comp[1];
+    info->subsampling_y[c] = comp[2];
+  }
+
+  return true;
+}
+
+static bool parse_cod(const uint8_t* seg, uint32_t len, kduc_info* info) {
+  if (len < 10)
+    return false;
+
+  info->progression = seg[1];
+  info->num_layers = (int)get_u16(seg + 2);
+  info->uses_mct = seg[4] != 0;
+  info->num_levels = seg[5];
+  info->block_width = 1 << ((seg[6] & 0x0F) + 2);
+  info->block_height = 1 << ((seg[7] & 0x0F) + 2);
+  info->block_style = seg[8];
+  info->is_reversible = seg[9] == 1;
+
+  if (!(info->block_style & 0x40))
+    info->block_coder = KDU_BLOCK_CODER_LEGACY;
+  else if (info->block_style & 0x80)
+    info->block_coder = KDU_BLOCK_CODER_HT_MIXED;
+  else
+    info->block_coder = KDU_BLOCK_CODER_HT;
+
+  return true;
+}
+
+int kduc_probe(const uint8_t* data, size_t size, kduc_info* info) {
+  const uint32_t SOC = 0xFF4F;
+  const uint32_t SIZ = 0xFF51;
+  const uint32_t COD = 0xFF52;
+  const uint32_t QCD = 0xFF5C;
+  const uint32_t CAP = 0xFF50;
+  const uint32_t TLM = 0xFF55;
+  const uint32_t SOT = 0xFF90;
+
+  bool has_siz = false;
+  bool has_cod = false;
+  bool has_sot = false;
+
+  memset(info, 0, sizeof(*info));
+
+  if (size < 2 || get_u16(data) != SOC)
+    return 1;
+
+  /* walks the marker segments of the main header, which ends at the first SOT */
+
+  for (size_t pos = 2; pos + 4 <= size;) {
+    uint32_t marker = get_u16(data + pos);
+
+    if (marker == SOT) {
+      has_sot = true;
+      break;
+    }
+
+    if ((marker & 0xFF00) != 0xFF00)
+      return 1;
+
+    uint32_t len = get_u16(data + pos + 2);
+
+    if (len < 2 || pos + 2 + len > size)
+      return 1;
+
+    const uint8_t* seg = data + pos + 4;
+    uint32_t seg_len = len - 2;
+
+    switch (marker) {
+      case SIZ:
+        if (!parse_siz(seg, seg_len, info))
+          return 1;
+        has_siz = true;
+        break;
+      case COD:
+        if (!parse_cod(seg, seg_len, info))
+          return 1;
+        has_cod = true;
+        break;
+      case QCD:
+        if (seg_len < 1)
+          return 1;
+        info->quantization_style = seg[0] & 0x1F;
+        info->guard_bits = seg[0] >> 5;
+        break;
+      case CAP:
+        if (seg_len < 4)
+          return 1;
+        info->capabilities = get_u32(seg);
+        break;
+      case TLM:
+        info->has_tlm = true;
+        break;
+    }
+
+    pos += 2 + len;
+  }
+
+  /* a header that ends before its first tile-part may lack markers, e.g. CAP,
+     and is therefore rejected */
+
+  return !(has_siz && has_cod && has_sot);
+}
+
+/**
+ *  kdu_compressed_source_buffered
+ */
+
+int kdu_compressed_source_buffered_new(const unsigned char* cs,
+                                       const unsigned long int len,
+                                       kdu_compressed_source** out) {
+  try {
+    *out = new kdu_core::kdu_compressed_source_buffered((kdu_core::kdu_byte*)cs,
+                                                        len);
+  } catch (...) {
+    return 1;
+  }
+  return 0;
+}
+
+void kdu_compressed_source_buffered_delete(kdu_compressed_source* cs) {
+  delete cs;
+}
+
+/**
+ *  kdu_compressed_source_file
+ */
+
+#ifndef _WIN32
+
+class mmap_compressed_source : public mem_compressed_source {
+ public:
+  mmap_compressed_source() : addr(MAP_FAILED), length(0) {}
+
+  ~mmap_compressed_source() {
+    if (this->addr != MAP_FAILED)
+      munmap(this->addr, this->length);
+  }
+
+  bool open(const char* path) {
+    int fd = ::open(path, O_RDONLY);
+
+    if (fd < 0)
+      return false;
 
-/**
- *  kdu_codestream
- */
+    struct stat st;
 
-int kdu_codestream_create_from_source(kdu_compressed_source* source,
-                                      kdu_codestream** cs) {
-  try {
-    *cs = new kdu_supp::kdu_codestream();
+    if (fstat(fd, &st) || st.st_size <= 0) {
+      ::close(fd);
+      return false;
+    }
 
-    (*cs)->create(source);
+    this->length = (size_t)st.st_size;
+    this->addr = mmap(NULL, this->length, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    /* the mapping remains valid after the file is closed */
+
+    ::close(fd);
+
+    if (this->addr == MAP_FAILED)
+      return false;
+
+    this->reset((const kdu_core::kdu_byte*)this->addr, this->length);
+
+    return true;
+  }
+
+ private:
+  void* addr;
+  size_t length;
+};
+
+int kdu_compressed_source_file_new(const char* path,
+                                   kdu_compressed_source** out) {
+  mmap_compressed_source* source;
+
+  try {
+    source = new mmap_compressed_source();
   } catch (...) {
     return 1;
   }
+
+  if (!source->open(path)) {
+    delete source;
+    return 1;
+  }
+
+  *out = source;
+
   return 0;
 }
 
-int kdu_codestream_create_from_target(mem_compressed_target* target,
-                                      kdu_siz_params* sz,
-                                      kdu_codestream** cs) {
-  try {
-    static_cast<kdu_core::kdu_params*>(sz)->finalize();
+#else
 
-    *cs = new kdu_supp::kdu_codestream();
+int kdu_compressed_source_file_new(const char* path,
+                                   kdu_compressed_source** out) {
+  return 1;
+}
 
-    (*cs)->create(sz, target);
+#endif
+
+void kdu_compressed_source_file_delete(kdu_compressed_source* cs) {
+  delete cs;
+}
+
+/**
+ *  kdu_compressed_source_callback
+ */
+
+class callback_compressed_source : public kdu_core::kdu_compressed_source {
+ public:
+  callback_compressed_source(const kdu_compressed_source_callbacks* callbacks,
+                             void* user)
+      : callbacks(*callbacks), user(user) {}
+
+  ~callback_compressed_source() { this->close(); }
+
+  int get_capabilities() {
+    if (this->callbacks.seek && this->callbacks.get_pos)
+      return KDU_SOURCE_CAP_SEQUENTIAL | KDU_SOURCE_CAP_SEEKABLE;
+
+    return KDU_SOURCE_CAP_SEQUENTIAL;
+  }
+
+  int read(kdu_core::kdu_byte* buf, int num_bytes) {
+    return std::max(this->callbacks.read(this->user, buf, num_bytes), 0);
+  }
+
+  bool seek(kdu_core::kdu_long offset) {
+    if (!this->callbacks.seek)
+      return false;
+
+    return this->callbacks.seek(this->user, offset);
+  }
+
+  kdu_core::kdu_long get_pos() {
+    if (!this->callbacks.get_pos)
+      return -1;
+
+    return this->callbacks.get_pos(this->user);
+  }
+
+  bool close() {
+    if (this->callbacks.close)
+      this->callbacks.close(this->user);
+
+    this->callbacks.close = NULL;
+
+    return true;
+  }
+
+ private:
+  kdu_compressed_source_callbacks callbacks;
+  void* user;
+};
+
+int kdu_compressed_source_callback_new(
+    const kdu_compressed_source_callbacks* callbacks,
+    void* user,
+    kdu_compressed_source** out) {
+  if (!callbacks->read)
+    return 1;
 
+  try {
+    *out = new callback_compressed_source(callbacks, user);
   } catch (...) {
     return 1;
   }
+
   return 0;
 }
 
-void kdu_codestream_get_size(kdu_codestream* cs,
-                             int comp_idx,
-                             int* height,
-                             int* width) {
-  kdu_core::kdu_dims dims;
-  cs->get_dims(comp_idx, dims);
-  *height = dims.size.y;
-  *width = dims.size.x;
+void kdu_compressed_source_callback_delete(kdu_compressed_source* cs) {
+  delete cs;
 }
 
-void kdu_codestream_get_subsampling(kdu_codestream* cs,
-                                    int comp_idx,
-                                    int* x,
-                                    int* y) {
-  kdu_core::kdu_coords coords;
-  cs->get_min_subsampling(comp_idx, coords);
-  *x = coords.x;
-  *y = coords.y;
-}
+/**
+ *  kduc_decode_batch
+ */
 
-int kdu_codestream_get_num_components(kdu_codestream* cs) {
-  return cs->get_num_components();
-}
+class decode_batch : public kduc_batch {
+ public:
+  decode_batch(kduc_decode_frame* frames, int frame_count)
+      : kduc_batch(frame_count), frames(frames) {}
 
-int kdu_codestream_get_depth(kdu_codestream* cs, int comp_idx) {
-  return cs->get_bit_depth(comp_idx);
-}
+  kduc_decode_frame* frames;
+};
 
-bool kdu_codestream_get_signed(kdu_codestream* cs, int comp_idx) {
-  return cs->get_signed(comp_idx);
-}
+static kdu_core::kdu_thread_startproc_result KDU_THREAD_STARTPROC_CALL_CONVENTION
+decode_batch_worker(void* param) {
+  decode_batch* batch = (decode_batch*)param;
+  kduc_stripe_decompressor dec;
+  mem_compressed_source source;
 
-void kdu_codestream_delete(kdu_codestream* cs) {
-  cs->destroy();
-  delete cs;
+  for (int i = batch->take(); i >= 0; i = batch->take())
+    batch->frames[i].result = decode_frame(dec, source, batch->frames + i);
+
+  return KDU_THREAD_STARTPROC_ZERO_RESULT;
 }
 
-int kdu_codestream_parse_params(kdu_codestream* cs, const char* params) {
-  if ((!cs->access_siz()->parse_string(params)))
-    return 1;
+int kduc_decode_batch(kduc_decode_frame* frames,
+                      int frame_count,
+                      int worker_count) {
+  if (frame_count <= 0)
+    return 0;
 
-  return 0;
-}
+  try {
+    decode_batch batch(frames, frame_count);
 
-void kdu_codestream_discard_levels(kdu_codestream* cs, int discard_levels) {
-  cs->apply_input_restrictions(0, 0, discard_levels, 0, NULL);
-}
+    run_workers(get_worker_count(worker_count, frame_count),
+                decode_batch_worker, &batch);
+  } catch (...) {
+    return 1;
+  }
 
-void kdu_codestream_textualize_params(kdu_codestream* cs,
-                                      kdu_message_handler_func handler) {
-  warning_message_handler msg_handler;
+  for (int i = 0; i < frame_count; i++) {
+    if (frames[i].result)
+      return 1;
+  }
 
-  msg_handler.set_handler(handler);
-  cs->access_siz()->textualize_attributes(msg_handler, false);
+  return 0;
 }
 
 /**
- *  kdu_compressed_source_buffered
+ *  kduc_encode_tiled
  */
 
-int kdu_compressed_source_buffered_new(const unsigned char* cs,
-                                       const unsigned long int len,
-                                       kdu_compressed_source** out) {
+int kduc_encode_tiled(kdu_codestream* cs,
+                      const kdu_stripe_compressor_options* opts,
+                      kduc_sample_type sample_type,
+                      const int* precisions,
+                      const bool* is_signed,
+                      kduc_row_reader_func reader,
+                      void* user) {
+  kdu_stripe_compressor_options tiled_opts = *opts;
+  kduc_stripe_compressor enc;
+  kdu_core::kdu_dims tiles;
+  int tile_height = 0;
+
   try {
-    *out = new kdu_core::kdu_compressed_source_buffered((kdu_core::kdu_byte*)cs,
-                                                        len);
+    cs->get_valid_tiles(tiles);
+    cs->access_siz()->get(Stiles, 0, 0, tile_height);
   } catch (...) {
     return 1;
   }
-  return 0;
-}
 
-void kdu_compressed_source_buffered_delete(kdu_compressed_source* cs) {
-  delete cs;
+  if (tiled_opts.thread_count == 0 && !tiled_opts.pool)
+    tiled_opts.thread_count = kdu_core::kdu_get_num_processors();
+
+  if (tiled_opts.tile_concurrency < 0)
+    tiled_opts.tile_concurrency = tiles.size.x;
+
+  if (kdu_stripe_compressor_start(&enc, cs, &tiled_opts))
+    return 1;
+
+  int ret = kdu_stripe_compressor_push_rows(&enc, cs, sample_type, precisions,
+                                            is_signed, tile_height, reader,
+                                            user);
+
+  return kdu_stripe_compressor_finish(&enc) || ret;
 }
 
 /**
@@ -521,6 +2407,23 @@ int kdu_compressed_target_mem_new(mem_compressed_target** target) {
   return 0;
 }
 
+int kdu_compressed_target_mem_new_with_buffer(unsigned char* buf,
+                                              size_t capacity,
+                                              kdu_realloc_func realloc_func,
+                                              void* user,
+                                              mem_compressed_target** target) {
+  if (!realloc_func)
+    return 1;
+
+  try {
+    *target = new mem_compressed_target(buf, capacity, realloc_func, user);
+  } catch (...) {
+    return 1;
+  }
+
+  return 0;
+}
+
 void kdu_compressed_target_mem_delete(mem_compressed_target* target) {
   delete target;
 }
@@ -528,6 +2431,311 @@ void kdu_compressed_target_mem_delete(mem_compressed_target* target) {
 void kdu_compressed_target_bytes(mem_compressed_target* target,
                                  unsigned char** data,
                                  int* sz) {
-  *data = target->get_buffer().data();
-  *sz = target->get_buffer().size();
+  *data = target->get_data();
+  *sz = (int)target->get_size();
+}
+
+void kdu_compressed_target_detach(mem_compressed_target* target,
+                                  unsigned char** data,
+                                  size_t* sz) {
+  *sz = target->get_size();
+  *data = target->detach();
+}
+
+void kdu_compressed_target_get_stats(mem_compressed_target* target,
+                                     kduc_target_stats* stats) {
+  *stats = target->get_stats();
+}
+
+void kdu_compressed_target_reset_stats(mem_compressed_target* target) {
+  target->reset_stats();
+}
+
+/**
+ * file_compressed_target
+ */
+
+void kdu_compressed_target_file_options_init(
+    kdu_compressed_target_file_options* opts) {
+  opts->block_size = 0;
+  opts->direct = false;
+}
+
+#ifndef _WIN32
+
+class file_compressed_target : public kdu_core::kdu_compressed_target {
+ public:
+  /* alignment required of `O_DIRECT` writes */
+  static const size_t ALIGNMENT = 4096;
+
+  file_compressed_target()
+      : fd(-1),
+        base(0),
+        block(NULL),
+        sector(NULL),
+        block_size(0),
+        fill(0),
+        flushed(0),
+        rewrite_pos(-1),
+        saved_flags(-1),
+        is_direct(false) {}
+
+  ~file_compressed_target() {
+    this->close();
+    free(this->block);
+    free(this->sector);
+  }
+
+  bool open(int fd, const kdu_compressed_target_file_options* opts) {
+    this->fd = fd;
+    this->base = lseek(fd, 0, SEEK_CUR);
+
+    if (this->base < 0)
+      return false;
+
+    this->block_size = opts->block_size ? opts->block_size : 4 << 20;
+    this->block_size = (this->block_size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+
+    if (posix_memalign((void**)&this->block, ALIGNMENT, this->block_size))
+      return false;
+
+#ifdef O_DIRECT
+    int flags = fcntl(fd, F_GETFL);
+
+    /* rewrites read back sectors, which requires a readable `fd` */
+
+    if (opts->direct && this->base % ALIGNMENT == 0 && flags >= 0 &&
+        (flags & O_ACCMODE) == O_RDWR) {
+      if (posix_memalign((void**)&this->sector, ALIGNMENT, ALIGNMENT))
+        return false;
+
+      this->is_direct = fcntl(fd, F_SETFL, flags | O_DIRECT) == 0;
+
+      if (this->is_direct)
+        this->saved_flags = flags;
+    }
+#endif
+
+    return true;
+  }
+
+  bool write(const kdu_core::kdu_byte* buf, int num_bytes) {
+    if (this->rewrite_pos >= 0)
+      return this->rewrite(buf, num_bytes);
+
+    while (num_bytes > 0) {
+      size_t count = std::min((size_t)num_bytes, this->block_size - this->fill);
+
+      memcpy(this->block + this->fill, buf, count);
+
+      this->fill += count;
+      buf += count;
+      num_bytes -= (int)count;
+
+      if (this->fill == this->block_size) {
+        if (!this->write_at(this->block, this->block_size, this->flushed))
+          return false;
+
+        this->flushed += this->block_size;
+        this->fill = 0;
+      }
+    }
+
+    return true;
+  }
+
+  bool prefer_large_writes() const { return true; }
+
+  bool start_rewrite(kdu_core::kdu_long backtrack) {
+    kdu_core::kdu_long size = this->flushed + this->fill;
+
+    if (this->rewrite_pos >= 0 || backtrack < 0 || backtrack > size)
+      return false;
+
+    this->rewrite_pos = size - backtrack;
+    return true;
+  }
+
+  bool end_rewrite() {
+    if (this->rewrite_pos < 0)
+      return false;
+
+    this->rewrite_pos = -1;
+    return true;
+  }
+
+  bool close() {
+    if (this->fd < 0)
+      return true;
+
+    bool is_ok = true;
+
+    if (this->fill > 0) {
+      size_t count = this->fill;
+
+      /* the last block is padded to satisfy `O_DIRECT`, and then truncated */
+
+      if (this->is_direct) {
+        count = (count + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+        memset(this->block + this->fill, 0, count - this->fill);
+      }
+
+      is_ok = this->write_at(this->block, count, this->flushed);
+
+      if (is_ok && this->is_direct)
+        is_ok = ftruncate(this->fd, this->base + this->flushed + this->fill) == 0;
+
+      this->flushed += this->fill;
+      this->fill = 0;
+    }
+
+    /* the caller's descriptor is handed back as it was opened */
+
+    if (this->saved_flags >= 0 && fcntl(this->fd, F_SETFL, this->saved_flags))
+      is_ok = false;
+
+    this->saved_flags = -1;
+    this->fd = -1;
+
+    return is_ok;
+  }
+
+ private:
+  bool write_at(const kdu_core::kdu_byte* buf,
+                size_t num_bytes,
+                kdu_core::kdu_long pos) {
+    while (num_bytes > 0) {
+      ssize_t count = pwrite(this->fd, buf, num_bytes, this->base + pos);
+
+      if (count <= 0)
+        return false;
+
+      buf += count;
+      num_bytes -= count;
+      pos += count;
+    }
+
+    return true;
+  }
+
+  /* overwrites bytes that have already been written, either in the current
+     block or in the file */
+  bool rewrite(const kdu_core::kdu_byte* buf, int num_bytes) {
+    if (this->rewrite_pos + num_bytes >
+        this->flushed + (kdu_core::kdu_long)this->fill)
+      return false;
+
+    while (num_bytes > 0 && this->rewrite_pos < this->flushed) {
+      size_t count;
+
+      if (this->is_direct) {
+        /* read-modify-write of the aligned sector holding `rewrite_pos`, which
+           lies entirely in the file since `flushed` is a multiple of the
+           block size */
+
+        kdu_core::kdu_long sector_pos = this->rewrite_pos / ALIGNMENT * ALIGNMENT;
+        size_t offset = (size_t)(this->rewrite_pos - sector_pos);
+
+        count = std::min((size_t)num_bytes, ALIGNMENT - offset);
+
+        if (pread(this->fd, this->sector, ALIGNMENT, this->base + sector_pos) !=
+            (ssize_t)ALIGNMENT)
+          return false;
+
+        memcpy(this->sector + offset, buf, count);
+
+        if (!this->write_at(this->sector, ALIGNMENT, sector_pos))
+          return false;
+      } else {
+        count = (size_t)std::min((kdu_core::kdu_long)num_bytes,
+                                 this->flushed - this->rewrite_pos);
+
+        if (!this->write_at(buf, count, this->rewrite_pos))
+          return false;
+      }
+
+      buf += count;
+      num_bytes -= (int)count;
+      this->rewrite_pos += count;
+    }
+
+    if (num_bytes > 0) {
+      memcpy(this->block + (this->rewrite_pos - this->flushed), buf, num_bytes);
+      this->rewrite_pos += num_bytes;
+    }
+
+    return true;
+  }
+
+  int fd;
+  off_t base;
+  kdu_core::kdu_byte* block;
+  kdu_core::kdu_byte* sector;
+  size_t block_size;
+  size_t fill;
+  kdu_core::kdu_long flushed;
+  kdu_core::kdu_long rewrite_pos;
+  int saved_flags;                    /* flags of `fd` before `O_DIRECT` was set */
+  bool is_direct;
+
+  /* not copyable, since `block` and `sector` are freed by the destructor */
+  file_compressed_target(const file_compressed_target&);
+  file_compressed_target& operator=(const file_compressed_target&);
+};
+
+int kdu_compressed_target_file_new(int fd,
+                                   const kdu_compressed_target_file_options* opts,
+                                   file_compressed_target** target) {
+  file_compressed_target* t;
+
+  try {
+    t = new file_compressed_target();
+  } catch (...) {
+    return 1;
+  }
+
+  if (!t->open(fd, opts)) {
+    delete t;
+    return 1;
+  }
+
+  *target = t;
+
+  return 0;
 }
+
+int kdu_compressed_target_file_close(file_compressed_target* target) {
+  return !target->close();
+}
+
+void kdu_compressed_target_file_delete(file_compressed_target* target) {
+  delete target;
+}
+
+int kdu_codestream_create_from_file_target(file_compressed_target* target,
+                                           kdu_siz_params* sz,
+                                           kdu_codestream** cs) {
+  return create_from_target(target, sz, cs);
+}
+
+#else
+
+int kdu_compressed_target_file_new(int fd,
+                                   const kdu_compressed_target_file_options* opts,
+                                   file_compressed_target** target) {
+  return 1;
+}
+
+int kdu_compressed_target_file_close(file_compressed_target* target) {
+  return 1;
+}
+
+void kdu_compressed_target_file_delete(file_compressed_target* target) {}
+
+int kdu_codestream_create_from_file_target(file_compressed_target* target,
+                                           kdu_siz_params* sz,
+                                           kdu_codestream** cs) {
+  return 1;
+}
+
+#endif
@@ -28,37 +28,219 @@
 #define KDUC_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+/**
+ * Resizes the memory block at `ptr`, which is NULL for a new block, to `size`
+ * bytes and returns the resized block, or NULL on failure. The block is freed
+ * if `size` is 0.
+ */
+typedef void* (*kdu_realloc_func)(void* ptr, size_t size, void* user);
+
+/**
+ * Performance counters of a compressor or decompressor. Times are in
+ * nanoseconds and are only collected while enabled. CPU times are those of the
+ * whole process, and therefore include the time spent by Kakadu worker threads.
+ */
+typedef struct kduc_stripe_stats {
+  int64_t start_wall_ns;
+  int64_t start_cpu_ns;
+  int64_t stripe_wall_ns;             /* spent pushing or pulling stripes */
+  int64_t stripe_cpu_ns;
+  int64_t finish_wall_ns;
+  int64_t finish_cpu_ns;
+  int64_t stripe_count;               /* number of stripes pushed or pulled */
+} kduc_stripe_stats;
+
+/**
+ * Counters of a `mem_compressed_target`, which are always collected.
+ */
+typedef struct kduc_target_stats {
+  int64_t write_count;                /* number of calls to `write` */
+  int64_t bytes_written;
+  int64_t realloc_count;              /* number of buffer reallocations */
+  int64_t rewrite_count;              /* number of rewrites, e.g. of TLM markers */
+  int64_t peak_size;                  /* largest size of the buffered codestream, in bytes */
+} kduc_target_stats;
+
 #ifdef __cplusplus
 
-#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
 #include "kdu_stripe_compressor.h"
 #include "kdu_stripe_decompressor.h"
 #include "kdu_elementary.h"
 
-typedef kdu_supp::kdu_stripe_decompressor kdu_stripe_decompressor;
-typedef kdu_supp::kdu_stripe_compressor kdu_stripe_compressor;
+class kduc_thread_pool {
+ public:
+  kduc_thread_pool() : borrower_count(0) {
+    this->mutex.create();
+    this->returned.create(true);
+  }
+
+  ~kduc_thread_pool() {
+    if (this->env.exists()) {
+      /* the last borrower may have run on another thread */
+      this->mutex.lock();
+      this->env.change_group_owner_thread();
+      this->mutex.unlock();
+
+      this->env.destroy();
+    }
+    this->returned.destroy();
+    this->mutex.destroy();
+  }
+
+  /* attaches `queue` to `env` on behalf of the calling thread, waiting until
+     jobs driven from other threads are finished */
+  void borrow(kdu_core::kdu_thread_queue* queue);
+
+  /* joins `queue`, which must have been attached by the calling thread */
+  void give_back(kdu_core::kdu_thread_queue* queue);
+
+  kdu_core::kdu_thread_env env;
+
+ private:
+  /* only the thread that owns `env` can drive jobs on it, and ownership
+     changes only once all of its jobs are finished */
+  int borrower_count;
+  kdu_core::kdu_thread owner;
+  kdu_core::kdu_mutex mutex;
+  kdu_core::kdu_event returned;
+
+  /* not copyable, since the threads are owned by the pool */
+  kduc_thread_pool(const kduc_thread_pool&);
+  kduc_thread_pool& operator=(const kduc_thread_pool&);
+};
+
+/* threads used by a compressor or decompressor, which are either owned by
+   the instance or borrowed from a `kduc_thread_pool` between start and finish */
+class kduc_threads {
+ public:
+  kduc_threads() : thread_count(0), pool(NULL) {}
+
+  ~kduc_threads() {
+    this->release();
+    if (this->env.exists())
+      this->env.destroy();
+  }
+
+  /* returns the environment to use for the next job, or NULL if the job is
+     single-threaded */
+  kdu_core::kdu_thread_env* acquire(int thread_count, kduc_thread_pool* pool);
+
+  /* returns the queue to use for the current job, or NULL */
+  kdu_core::kdu_thread_queue* get_queue() {
+    return this->pool ? &this->queue : NULL;
+  }
+
+  /* waits for the current job and returns any borrowed pool */
+  void release();
+
+  /* notifies the threads of the current job that it failed with `e`, as
+     required by Kakadu before the job is finished, and returns any borrowed
+     pool */
+  void abort(kdu_core::kdu_exception e);
+
+ private:
+  kdu_core::kdu_thread_env env;
+  int thread_count;
+  kduc_thread_pool* pool;
+  kdu_core::kdu_thread_queue queue;
+};
+
+class kduc_stripe_compressor : public kdu_supp::kdu_stripe_compressor {
+ public:
+  kduc_stripe_compressor() : is_stats_enabled(false), frame_id(0) {
+    memset(&this->stats, 0, sizeof(this->stats));
+  }
+
+  kduc_threads threads;
+  bool is_stats_enabled;
+  kduc_stripe_stats stats;
+  uint64_t frame_id;
+};
+
+class kduc_stripe_decompressor : public kdu_supp::kdu_stripe_decompressor {
+ public:
+  kduc_stripe_decompressor() : is_stats_enabled(false), frame_id(0) {
+    memset(&this->stats, 0, sizeof(this->stats));
+  }
+
+  kduc_threads threads;
+  bool is_stats_enabled;
+  kduc_stripe_stats stats;
+  uint64_t frame_id;
+};
+
+class kduc_sequence_encoder;
+
+class kduc_sequence_decoder;
+
+class kduc_async;
+
+class file_compressed_target;
+
+typedef kduc_stripe_decompressor kdu_stripe_decompressor;
+typedef kduc_stripe_compressor kdu_stripe_compressor;
 typedef kdu_supp::kdu_codestream kdu_codestream;
 typedef kdu_supp::kdu_compressed_source kdu_compressed_source;
 typedef kdu_core::siz_params kdu_siz_params;
 
 class mem_compressed_target : public kdu_core::kdu_compressed_target {
  public:
-  mem_compressed_target(): backtrack(-1) {}
+  mem_compressed_target()
+      : buf(NULL),
+        size(0),
+        capacity(0),
+        backtrack(-1),
+        realloc_func(default_realloc),
+        user(NULL) {
+    memset(&this->stats, 0, sizeof(this->stats));
+  }
+
+  /* writes into `buf`, which holds `capacity` bytes and is resized using
+     `realloc_func` */
+  mem_compressed_target(uint8_t* buf,
+                        size_t capacity,
+                        kdu_realloc_func realloc_func,
+                        void* user)
+      : buf(buf),
+        size(0),
+        capacity(buf ? capacity : 0),
+        backtrack(-1),
+        realloc_func(realloc_func),
+        user(user) {
+    memset(&this->stats, 0, sizeof(this->stats));
+  }
+
+  ~mem_compressed_target() {
+    if (this->buf)
+      this->realloc_func(this->buf, 0, this->user);
+  }
 
   bool close() {
-    this->buf.clear();
+    this->size = 0;
     return true;
   }
 
   bool write(const kdu_core::kdu_byte* buf, int num_bytes) {
+    this->stats.write_count++;
+    this->stats.bytes_written += num_bytes;
+
     if (this->backtrack < 0) {
-      std::copy(buf, buf + num_bytes, std::back_inserter(this->buf));
+      if (!this->reserve(this->size + num_bytes, true))
+        return false;
+      memcpy(this->buf + this->size, buf, num_bytes);
+      this->size += num_bytes;
+      this->stats.peak_size =
+          std::max(this->stats.peak_size, (int64_t)this->size);
     } else if (num_bytes > this->backtrack) {
       return false;
     } else {
-      std::copy(buf, buf + num_bytes, this->buf.end() - this->backtrack);
+      memcpy(this->buf + this->size - this->backtrack, buf, num_bytes);
       this->backtrack -= num_bytes;
     }
 
@@ -66,18 +248,40 @@ class mem_compressed_target : public kdu_core::kdu_compressed_target {
   }
 
   void set_target_size(kdu_core::kdu_long num_bytes) {
-    this->buf.reserve(num_bytes);
+    if (num_bytes > 0)
+      this->reserve((size_t)num_bytes, false);
   }
 
-  bool prefer_large_writes() const { return false; }
+  bool prefer_large_writes() const { return true; }
+
+  /* `get_data()` and `get_size()` replace `get_buffer()`, since the codestream
+     is no longer held in a `std::vector` */
+  uint8_t* get_data() { return this->buf; }
+
+  size_t get_size() const { return this->size; }
+
+  const kduc_target_stats& get_stats() const { return this->stats; }
+
+  void reset_stats() { memset(&this->stats, 0, sizeof(this->stats)); }
 
-  std::vector<uint8_t>& get_buffer() { return this->buf; }
+  /* releases ownership of the buffer, which must then be freed using the
+     target's `kdu_realloc_func`, or `free()` by default */
+  uint8_t* detach() {
+    uint8_t* data = this->buf;
+
+    this->buf = NULL;
+    this->size = 0;
+    this->capacity = 0;
+
+    return data;
+  }
 
   bool start_rewrite(kdu_core::kdu_long backtrack) {
-    if (backtrack > this->buf.size() || backtrack < 0)
+    if (backtrack > (kdu_core::kdu_long)this->size || backtrack < 0)
       return false;
 
     this->backtrack = backtrack;
+    this->stats.rewrite_count++;
     return true;
   }
 
@@ -90,8 +294,92 @@ class mem_compressed_target : public kdu_core::kdu_compressed_target {
   }
 
  private:
-  std::vector<uint8_t> buf;
+  /* ensures that at least `min_capacity` bytes are allocated, growing the
+     buffer geometrically if `is_growing` */
+  bool reserve(size_t min_capacity, bool is_growing) {
+    if (min_capacity <= this->capacity)
+      return true;
+
+    size_t new_capacity = min_capacity;
+
+    if (is_growing)
+      new_capacity = std::max(min_capacity, std::max(this->capacity * 2, (size_t)4096));
+
+    uint8_t* new_buf =
+        (uint8_t*)this->realloc_func(this->buf, new_capacity, this->user);
+
+    if (!new_buf)
+      return false;
+
+    this->buf = new_buf;
+    this->capacity = new_capacity;
+    this->stats.realloc_count++;
+
+    return true;
+  }
+
+  static void* default_realloc(void* ptr, size_t size, void* /* user */) {
+    if (size == 0) {
+      free(ptr);
+      return NULL;
+    }
+
+    return realloc(ptr, size);
+  }
+
+  uint8_t* buf;
+  size_t size;
+  size_t capacity;
   kdu_core::kdu_long backtrack;
+  kdu_realloc_func realloc_func;
+  void* user;
+  kduc_target_stats stats;
+
+  /* not copyable, since `buf` is freed by the destructor */
+  mem_compressed_target(const mem_compressed_target&);
+  mem_compressed_target& operator=(const mem_compressed_target&);
+};
+
+class mem_compressed_source : public kdu_core::kdu_compressed_source {
+ public:
+  mem_compressed_source() : data(NULL), size(0), pos(0) {}
+
+  /* reads from `data`, which must remain valid until the source is reset or
+     deleted */
+  void reset(const kdu_core::kdu_byte* data, size_t size) {
+    this->data = data;
+    this->size = size;
+    this->pos = 0;
+  }
+
+  int get_capabilities() {
+    return KDU_SOURCE_CAP_SEQUENTIAL | KDU_SOURCE_CAP_SEEKABLE;
+  }
+
+  int read(kdu_core::kdu_byte* buf, int num_bytes) {
+    size_t count = std::min((size_t)num_bytes, this->size - this->pos);
+
+    memcpy(buf, this->data + this->pos, count);
+    this->pos += count;
+
+    return (int)count;
+  }
+
+  bool seek(kdu_core::kdu_long offset) {
+    if (offset < 0)
+      return false;
+
+    this->pos = std::min((size_t)offset, this->size);
+
+    return true;
+  }
+
+  kdu_core::kdu_long get_pos() { return (kdu_core::kdu_long)this->pos; }
+
+ private:
+  const kdu_core::kdu_byte* data;
+  size_t size;
+  size_t pos;
 };
 
 extern "C" {
@@ -103,7 +391,12 @@ typedef struct kdu_stripe_compressor kdu_stripe_compressor;
 typedef struct kdu_codestream kdu_codestream;
 typedef struct kdu_compressed_source kdu_compressed_source;
 typedef struct mem_compressed_target mem_compressed_target;
+typedef struct file_compressed_target file_compressed_target;
 typedef struct siz_params kdu_siz_params;
+typedef struct kduc_thread_pool kduc_thread_pool;
+typedef struct kduc_sequence_encoder kduc_sequence_encoder;
+typedef struct kduc_sequence_decoder kduc_sequence_decoder;
+typedef struct kduc_async kduc_async;
 
 #endif
 
@@ -130,6 +423,43 @@ void kdu_register_info_handler(kdu_message_handler_func handler);
 
 void kdu_register_debug_handler(kdu_message_handler_func handler);
 
+/**
+ * tracing
+ */
+
+typedef enum kduc_trace_event {
+  KDUC_TRACE_COMPRESSOR_START = 0,
+  KDUC_TRACE_COMPRESSOR_PUSH_STRIPE,
+  KDUC_TRACE_COMPRESSOR_FINISH,
+  KDUC_TRACE_DECOMPRESSOR_START,
+  KDUC_TRACE_DECOMPRESSOR_PULL_STRIPE,
+  KDUC_TRACE_DECOMPRESSOR_FINISH,
+  KDUC_TRACE_CODESTREAM_CREATE,
+  KDUC_TRACE_CODESTREAM_DESTROY
+} kduc_trace_event;
+
+/**
+ * Called on the thread that performs `event`, once when it begins and once
+ * when it ends. `frame_id` is the identifier set using
+ * kdu_stripe_*_set_frame_id() or the `frame_id` of a batch or asynchronous
+ * frame, and is 0 otherwise.
+ */
+typedef void (*kduc_trace_func)(void* user,
+                                kduc_trace_event event,
+                                bool is_begin,
+                                uint64_t frame_id);
+
+/**
+ * Registers `handler`, or removes the current handler if `handler` is NULL.
+ * The handler must be registered while no compressor or decompressor is in
+ * use. Tracing costs a single test per event when no handler is registered.
+ *
+ * If kduc is built with `KDUC_USE_SDT`, the same events are also exposed as
+ * the `kduc:begin` and `kduc:end` USDT probes, with the event and the frame
+ * identifier as arguments, e.g. for use with `perf` or `bpftrace`.
+ */
+void kduc_register_trace_handler(kduc_trace_func handler, void* user);
+
 /**
  * kdu_codestream
  */
@@ -159,6 +489,10 @@ int kdu_codestream_create_from_target(mem_compressed_target* target,
                                       kdu_siz_params* sz,
                                       kdu_codestream** cs);
 
+int kdu_codestream_create_from_file_target(file_compressed_target* target,
+                                           kdu_siz_params* sz,
+                                           kdu_codestream** cs);
+
 int kdu_codestream_parse_params(kdu_codestream* cs, const char* params);
 
 void kdu_codestream_textualize_params(kdu_codestream* cs,
@@ -176,18 +510,173 @@ int kdu_compressed_source_buffered_new(const unsigned char* cs,
 
 void kdu_compressed_source_buffered_delete(kdu_compressed_source* cs);
 
+/**
+ * kdu_compressed_source_file
+ */
+
+/**
+ * Creates a seekable source that memory-maps the file at `path`, so that only
+ * the pages holding the bytes read by the decoder are loaded from storage.
+ */
+int kdu_compressed_source_file_new(const char* path,
+                                   kdu_compressed_source** out);
+
+void kdu_compressed_source_file_delete(kdu_compressed_source* cs);
+
+/**
+ * kdu_compressed_source_callback
+ */
+
+typedef struct kdu_compressed_source_callbacks {
+  int (*read)(void* user, unsigned char* buf, int num_bytes); /* returns the number of bytes read, 0 at the end of the codestream */
+  bool (*seek)(void* user, int64_t offset);                   /* offset from the start of the codestream; NULL if not seekable */
+  int64_t (*get_pos)(void* user);                             /* NULL if not seekable */
+  void (*close)(void* user);                                  /* may be NULL */
+} kdu_compressed_source_callbacks;
+
+/**
+ * Creates a source that pulls codestream bytes on demand through
+ * `callbacks`, which are passed `user`. The source is seekable if both
+ * `seek` and `get_pos` are provided, in which case only the byte ranges needed
+ * by restricted decodes are read. `close` is called once, when the source is
+ * deleted.
+ */
+int kdu_compressed_source_callback_new(
+    const kdu_compressed_source_callbacks* callbacks,
+    void* user,
+    kdu_compressed_source** out);
+
+void kdu_compressed_source_callback_delete(kdu_compressed_source* cs);
+
 /**
  * mem_compressed_target
  */
 
 int kdu_compressed_target_mem_new(mem_compressed_target** target);
 
+/**
+ * Creates a target that writes directly into caller-owned memory: `buf`, which
+ * holds `capacity` bytes and may be NULL, is resized using `realloc_func` as
+ * the codestream grows. The memory is freed by kdu_compressed_target_mem_delete()
+ * unless it is first detached using kdu_compressed_target_detach().
+ */
+int kdu_compressed_target_mem_new_with_buffer(unsigned char* buf,
+                                              size_t capacity,
+                                              kdu_realloc_func realloc_func,
+                                              void* user,
+                                              mem_compressed_target** target);
+
 void kdu_compressed_target_mem_delete(mem_compressed_target* target);
 
 void kdu_compressed_target_bytes(mem_compressed_target* target,
                                  unsigned char** data,
                                  int* sz);
 
+/**
+ * Transfers ownership of the codestream bytes to the caller, without copying.
+ * The memory must be freed using the `kdu_realloc_func` of the target, or
+ * `free()` if the target was created using kdu_compressed_target_mem_new().
+ * The target is left empty.
+ */
+void kdu_compressed_target_detach(mem_compressed_target* target,
+                                  unsigned char** data,
+                                  size_t* sz);
+
+void kdu_compressed_target_get_stats(mem_compressed_target* target,
+                                     kduc_target_stats* stats);
+
+void kdu_compressed_target_reset_stats(mem_compressed_target* target);
+
+/**
+ * file_compressed_target
+ */
+
+typedef struct kdu_compressed_target_file_options {
+  size_t block_size;                  /* size of the writes issued to the file, rounded up to a multiple of 4096 bytes; 0 selects 4 MiB */
+  bool direct;                        /* bypass the page cache using `O_DIRECT`, where supported and if `fd` is opened `O_RDWR` */
+} kdu_compressed_target_file_options;
+
+void kdu_compressed_target_file_options_init(
+    kdu_compressed_target_file_options* opts);
+
+/**
+ * Creates a target that writes the codestream to the file descriptor `fd`,
+ * starting at its current offset, in blocks of `opts->block_size` bytes.
+ * Rewrites, e.g. of TLM and PLT markers, are written in place using `pwrite()`.
+ * The caller retains ownership of `fd`.
+ *
+ * With `opts->direct`, `O_DIRECT` is set on `fd` until the target is closed,
+ * and rewrites read back the sectors they modify, so `fd` must be opened
+ * `O_RDWR`; otherwise the page cache is used.
+ */
+int kdu_compressed_target_file_new(int fd,
+                                   const kdu_compressed_target_file_options* opts,
+                                   file_compressed_target** target);
+
+/* writes any buffered bytes to the file, and must be called once the
+   compressor is finished */
+int kdu_compressed_target_file_close(file_compressed_target* target);
+
+void kdu_compressed_target_file_delete(file_compressed_target* target);
+
+/**
+ * kduc_thread_pool
+ */
+
+/**
+ * A pool of threads that is kept alive across jobs and that can be shared by
+ * any number of compressors and decompressors, which avoids the cost of
+ * creating threads for every job.
+ *
+ * A compressor or decompressor borrows the pool from
+ * kdu_stripe_*_start() until kdu_stripe_*_finish() or kdu_stripe_*_delete(),
+ * and runs its work in its own queue. Any number of jobs driven from the same
+ * thread run side by side on the pool, e.g. several decompressors whose
+ * stripes are pulled in turn. Jobs started from another thread wait until the
+ * jobs of that thread are all finished, since Kakadu only lets a single thread
+ * drive the pool at a time.
+ */
+
+/* creates a pool of `thread_count` threads, including the calling thread */
+int kduc_thread_pool_new(int thread_count, kduc_thread_pool** out);
+
+void kduc_thread_pool_delete(kduc_thread_pool* pool);
+
+/**
+ * kduc_sample_type
+ */
+
+typedef enum kduc_sample_type {
+  KDUC_SAMPLE_8 = 0,                  /* unsigned char */
+  KDUC_SAMPLE_16,                     /* int16_t */
+  KDUC_SAMPLE_32,                     /* int32_t */
+  KDUC_SAMPLE_FLOAT                   /* float */
+} kduc_sample_type;
+
+/**
+ * Reads `row_count` rows of component `comp_idx`, starting at row `first_row`,
+ * into `samples`, which holds `row_count` rows of `width` samples each.
+ * Returns 0 on success.
+ */
+typedef int (*kduc_row_reader_func)(void* user,
+                                    int comp_idx,
+                                    int first_row,
+                                    int row_count,
+                                    int width,
+                                    void* samples);
+
+/**
+ * Writes `row_count` rows of component `comp_idx`, starting at row
+ * `first_row`, from `samples`, which holds `row_count` rows of `width`
+ * samples each. Returns 0 on success.
+ */
+typedef int (*kduc_row_writer_func)(void* user,
+                                    int comp_idx,
+                                    int first_row,
+                                    int row_count,
+                                    int width,
+                                    const void* samples);
+
 /**
  * kdu_stripe_decompressor
  */
@@ -195,7 +684,19 @@ void kdu_compressed_target_bytes(mem_compressed_target* target,
 typedef struct kdu_stripe_decompressor_options {
   bool force_precise;
   bool want_fastest;
-  int reduce;
+  int reduce;                         /* number of highest resolution levels to discard */
+  int region_x;                       /* region of interest, relative to the top-left corner of the image ... */
+  int region_y;
+  int region_width;                   /* ... the entire image is decoded if `region_width` or `region_height` is 0 */
+  int region_height;
+  bool region_is_reduced;             /* the region is expressed on the image reduced by `reduce` rather than on the full-resolution image */
+  int max_layers;                     /* maximum number of quality layers to decode; 0 decodes all layers */
+  int component_count;                /* [0..KDU_MAX_COMPONENT_COUNT]; 0 decodes all output components */
+  int components[KDU_MAX_COMPONENT_COUNT]; /* indices of the codestream components to decode, in the order in which they are pulled */
+  int thread_count;                   /* total number of threads, including the caller; [0..1] disables multi-threading */
+  int dbuf_height;                    /* `env_dbuf_height` (see `kdu_stripe_decompressor.h`); -1 selects a default */
+  int tile_concurrency;               /* `env_tile_concurrency` (see `kdu_stripe_decompressor.h`); -1 selects a default */
+  kduc_thread_pool* pool;             /* if not NULL, threads are taken from `pool` and `thread_count` is ignored */
 } kdu_stripe_decompressor_options;
 
 void kdu_stripe_decompressor_options_init(
@@ -205,9 +706,21 @@ int kdu_stripe_decompressor_new(kdu_stripe_decompressor** out);
 
 void kdu_stripe_decompressor_delete(kdu_stripe_decompressor* dec);
 
-void kdu_stripe_decompressor_start(kdu_stripe_decompressor* dec,
-                                   kdu_codestream* cs,
-                                   const kdu_stripe_decompressor_options* opts);
+/**
+ * If `opts` specifies a resolution reduction, a region of interest, a maximum
+ * number of quality layers or a subset of components, only the corresponding
+ * code-blocks are decoded, and kdu_codestream_get_size() and
+ * kdu_codestream_get_num_components() describe the decoded image once the
+ * decompressor is started.
+ *
+ * If the codestream carries TLM and PLT markers (see `gen_tlm` and `gen_plt`)
+ * and its source is seekable, only the tile-parts and precincts that
+ * contribute to the decoded image are read. Buffered and file sources are
+ * seekable, as are callback sources that provide `seek` and `get_pos`.
+ */
+int kdu_stripe_decompressor_start(kdu_stripe_decompressor* dec,
+                                  kdu_codestream* cs,
+                                  const kdu_stripe_decompressor_options* opts);
 
 int kdu_stripe_decompressor_pull_stripe(kdu_stripe_decompressor* dec,
                                         unsigned char* pixels,
@@ -236,6 +749,28 @@ int kdu_stripe_decompressor_pull_stripe_16(kdu_stripe_decompressor* dec,
                                            const bool* is_signed,
                                            const int* pad_flags);
 
+int kdu_stripe_decompressor_pull_stripe_32(kdu_stripe_decompressor* dec,
+                                           int32_t* pixels,
+                                           const int* stripe_heights,
+                                           const int* sample_offsets,
+                                           const int* sample_gaps,
+                                           const int* row_gaps,
+                                           const int* precisions,
+                                           const bool* is_signed,
+                                           const int* pad_flags);
+
+/* `precisions` and `is_signed` set the nominal range of the samples, as
+   described for the `float` overloads of `kdu_stripe_decompressor::pull_stripe` */
+int kdu_stripe_decompressor_pull_stripe_float(kdu_stripe_decompressor* dec,
+                                              float* pixels,
+                                              const int* stripe_heights,
+                                              const int* sample_offsets,
+                                              const int* sample_gaps,
+                                              const int* row_gaps,
+                                              const int* precisions,
+                                              const bool* is_signed,
+                                              const int* pad_flags);
+
 int kdu_stripe_decompressor_pull_stripe_planar_16(kdu_stripe_decompressor* dec,
                                                   int16_t* pixels[],
                                                   const int* stripe_heights,
@@ -245,12 +780,76 @@ int kdu_stripe_decompressor_pull_stripe_planar_16(kdu_stripe_decompressor* dec,
                                                   const bool* is_signed,
                                                   const int* pad_flags);
 
+int kdu_stripe_decompressor_pull_stripe_planar_32(kdu_stripe_decompressor* dec,
+                                                  int32_t* pixels[],
+                                                  const int* stripe_heights,
+                                                  const int* sample_gaps,
+                                                  const int* row_gaps,
+                                                  const int* precisions,
+                                                  const bool* is_signed,
+                                                  const int* pad_flags);
+
+int kdu_stripe_decompressor_pull_stripe_planar_float(kdu_stripe_decompressor* dec,
+                                                     float* pixels[],
+                                                     const int* stripe_heights,
+                                                     const int* sample_gaps,
+                                                     const int* row_gaps,
+                                                     const int* precisions,
+                                                     const bool* is_signed,
+                                                     const int* pad_flags);
+
+/* see `kdu_stripe_decompressor::get_recommended_stripe_heights` */
+bool kdu_stripe_decompressor_get_recommended_stripe_heights(
+    kdu_stripe_decompressor* dec,
+    int preferred_min_height,
+    int absolute_max_height,
+    int* stripe_heights,
+    int* max_stripe_heights);
+
+/**
+ * Pulls the entire image in stripes of the recommended heights, no taller
+ * than `max_stripe_height` rows (0 selects 1024), and hands each stripe to
+ * `writer`, which is passed `user`. Only one stripe per component is held in
+ * memory at any time.
+ *
+ * `cs` is the codestream with which `dec` was started, and the decompressor
+ * must still be finished using kdu_stripe_decompressor_finish().
+ */
+int kdu_stripe_decompressor_pull_rows(kdu_stripe_decompressor* dec,
+                                      kdu_codestream* cs,
+                                      kduc_sample_type sample_type,
+                                      const int* precisions,
+                                      const bool* is_signed,
+                                      int max_stripe_height,
+                                      kduc_row_writer_func writer,
+                                      void* user);
+
+/* sets the identifier passed to the trace handler, e.g. a frame number */
+void kdu_stripe_decompressor_set_frame_id(kdu_stripe_decompressor* dec,
+                                          uint64_t frame_id);
+
+/* enables or disables the collection of times, which is disabled by default */
+void kdu_stripe_decompressor_enable_stats(kdu_stripe_decompressor* dec,
+                                          bool enable);
+
+void kdu_stripe_decompressor_get_stats(kdu_stripe_decompressor* dec,
+                                       kduc_stripe_stats* stats);
+
+void kdu_stripe_decompressor_reset_stats(kdu_stripe_decompressor* dec);
+
 int kdu_stripe_decompressor_finish(kdu_stripe_decompressor* dec);
 
 /**
  * kdu_stripe_compressor
  */
 
+typedef enum kdu_block_coder {
+  KDU_BLOCK_CODER_DEFAULT = 0,        /* determined by the `Cmodes` codestream parameter */
+  KDU_BLOCK_CODER_LEGACY,             /* JPEG 2000 Part 1 block coder */
+  KDU_BLOCK_CODER_HT,                 /* High-Throughput JPEG 2000 (Part 15) block coder */
+  KDU_BLOCK_CODER_HT_MIXED            /* HT block coder, with fallback to the Part 1 block coder */
+} kdu_block_coder;
+
 typedef struct kdu_stripe_compressor_options {
   bool force_precise;
   bool want_fastest;
@@ -259,6 +858,13 @@ typedef struct kdu_stripe_compressor_options {
   float rate[KDU_MAX_LAYER_COUNT];    /* target compression in bpp (see `-rate` in `kdu_compress`) */
   int slope_count;                    /* [0..KDU_MAX_LAYER_COUNT] */
   int slope[KDU_MAX_LAYER_COUNT];     /* distortion-length slope (see `kdu_stripe_compressor.h`) */
+  int thread_count;                   /* total number of threads, including the caller; [0..1] disables multi-threading */
+  int dbuf_height;                    /* `env_dbuf_height` (see `kdu_stripe_compressor.h`); -1 selects a default */
+  int tile_concurrency;               /* `env_tile_concurrency` (see `kdu_stripe_compressor.h`); -1 selects a default */
+  kduc_thread_pool* pool;             /* if not NULL, threads are taken from `pool` and `thread_count` is ignored */
+  kdu_block_coder block_coder;
+  int gen_tlm;                        /* `ORGgen_tlm`: if > 0, TLM markers are written, with room for this many tile-parts per tile */
+  bool gen_plt;                       /* `ORGgen_plt`: if true, PLT markers are written in each tile-part header */
 } kdu_stripe_compressor_options;
 
 void kdu_stripe_compressor_options_init(kdu_stripe_compressor_options* opts);
@@ -288,6 +894,26 @@ int kdu_stripe_compressor_push_stripe_16(kdu_stripe_compressor* enc,
                                          const int* precisions,
                                          const bool* is_signed);
 
+int kdu_stripe_compressor_push_stripe_32(kdu_stripe_compressor* enc,
+                                         int32_t* pixels,
+                                         const int* stripe_heights,
+                                         const int* sample_offsets,
+                                         const int* sample_gaps,
+                                         const int* row_gaps,
+                                         const int* precisions,
+                                         const bool* is_signed);
+
+/* `precisions` and `is_signed` set the nominal range of the samples, as
+   described for the `float` overloads of `kdu_stripe_compressor::push_stripe` */
+int kdu_stripe_compressor_push_stripe_float(kdu_stripe_compressor* enc,
+                                            float* pixels,
+                                            const int* stripe_heights,
+                                            const int* sample_offsets,
+                                            const int* sample_gaps,
+                                            const int* row_gaps,
+                                            const int* precisions,
+                                            const bool* is_signed);
+
 int kdu_stripe_compressor_push_stripe_planar(kdu_stripe_compressor* enc,
                                              unsigned char* pixels[],
                                              const int* stripe_heights,
@@ -303,8 +929,311 @@ int kdu_stripe_compressor_push_stripe_planar_16(kdu_stripe_compressor* enc,
                                                 const int* precisions,
                                                 const bool* is_signed);
 
+int kdu_stripe_compressor_push_stripe_planar_32(kdu_stripe_compressor* enc,
+                                                int32_t* pixels[],
+                                                const int* stripe_heights,
+                                                const int* sample_gaps,
+                                                const int* row_gaps,
+                                                const int* precisions,
+                                                const bool* is_signed);
+
+int kdu_stripe_compressor_push_stripe_planar_float(kdu_stripe_compressor* enc,
+                                                   float* pixels[],
+                                                   const int* stripe_heights,
+                                                   const int* sample_gaps,
+                                                   const int* row_gaps,
+                                                   const int* precisions,
+                                                   const bool* is_signed);
+
+/* see `kdu_stripe_compressor::get_recommended_stripe_heights` */
+bool kdu_stripe_compressor_get_recommended_stripe_heights(
+    kdu_stripe_compressor* enc,
+    int preferred_min_height,
+    int absolute_max_height,
+    int* stripe_heights,
+    int* max_stripe_heights);
+
+/**
+ * Pushes the entire image in stripes of the recommended heights, no taller
+ * than `max_stripe_height` rows (0 selects 1024), each of which is filled by
+ * `reader`, which is passed `user`. Only one stripe per component is held in
+ * memory at any time.
+ *
+ * `cs` is the codestream with which `enc` was started, and the compressor
+ * must still be finished using kdu_stripe_compressor_finish().
+ */
+int kdu_stripe_compressor_push_rows(kdu_stripe_compressor* enc,
+                                    kdu_codestream* cs,
+                                    kduc_sample_type sample_type,
+                                    const int* precisions,
+                                    const bool* is_signed,
+                                    int max_stripe_height,
+                                    kduc_row_reader_func reader,
+                                    void* user);
+
+/* sets the identifier passed to the trace handler, e.g. a frame number */
+void kdu_stripe_compressor_set_frame_id(kdu_stripe_compressor* enc,
+                                        uint64_t frame_id);
+
+/* enables or disables the collection of times, which is disabled by default */
+void kdu_stripe_compressor_enable_stats(kdu_stripe_compressor* enc,
+                                        bool enable);
+
+void kdu_stripe_compressor_get_stats(kdu_stripe_compressor* enc,
+                                     kduc_stripe_stats* stats);
+
+void kdu_stripe_compressor_reset_stats(kdu_stripe_compressor* enc);
+
 int kdu_stripe_compressor_finish(kdu_stripe_compressor* enc);
 
+/**
+ * kduc_probe
+ */
+
+/**
+ * Properties of a codestream, as signaled in its main header. Coding
+ * properties are the defaults of the COD and QCD markers, which COC and QCC
+ * markers or tile-part headers may override.
+ */
+typedef struct kduc_info {
+  uint16_t profile;                   /* Rsiz */
+  uint32_t capabilities;              /* Pcap, or 0 if there is no CAP marker */
+  uint32_t width;                     /* Xsiz - XOsiz */
+  uint32_t height;                    /* Ysiz - YOsiz */
+  uint32_t x_offset;
+  uint32_t y_offset;
+  uint32_t tile_width;
+  uint32_t tile_height;
+  uint32_t tile_x_offset;
+  uint32_t tile_y_offset;
+  uint32_t num_tiles;
+  int num_components;                 /* may exceed KDU_MAX_COMPONENT_COUNT */
+  int depths[KDU_MAX_COMPONENT_COUNT];
+  bool is_signed[KDU_MAX_COMPONENT_COUNT];
+  int subsampling_x[KDU_MAX_COMPONENT_COUNT];
+  int subsampling_y[KDU_MAX_COMPONENT_COUNT];
+  int progression;                    /* 0 = LRCP, 1 = RLCP, 2 = RPCL, 3 = PCRL, 4 = CPRL */
+  int num_layers;
+  bool uses_mct;                      /* multiple component transform */
+  int num_levels;                     /* number of wavelet decomposition levels */
+  int block_width;
+  int block_height;
+  int block_style;                    /* code-block style flags (Cmodes) */
+  bool is_reversible;                 /* 5-3 reversible wavelet transform */
+  kdu_block_coder block_coder;        /* never KDU_BLOCK_CODER_DEFAULT */
+  int quantization_style;             /* 0 = none, 1 = scalar derived, 2 = scalar expounded */
+  int guard_bits;
+  bool has_tlm;                       /* tile-parts can be located without reading them */
+} kduc_info;
+
+/**
+ * Reads the properties of the codestream in the `size` bytes at `data` by
+ * parsing its main header only, which is much faster than creating a
+ * `kdu_codestream`. Returns 0 on success, or 1 if the data ends before the SOT
+ * marker of the first tile-part, or if the main header lacks a SIZ or COD
+ * marker.
+ */
+int kduc_probe(const uint8_t* data, size_t size, kduc_info* info);
+
+/**
+ * kduc_sequence_encoder
+ */
+
+/**
+ * Encodes a sequence of frames that share the same geometry and coding
+ * parameters. The codestream and compressor are created for the first frame
+ * and restarted for every subsequent frame, so that per-frame setup is
+ * limited to restarting them against a new target.
+ *
+ * `sz` must remain valid until the first frame is started. `params` are
+ * parsed as by kdu_codestream_parse_params() and copied.
+ */
+int kduc_sequence_encoder_new(kdu_siz_params* sz,
+                              const char* const* params,
+                              int param_count,
+                              const kdu_stripe_compressor_options* opts,
+                              kduc_sequence_encoder** out);
+
+void kduc_sequence_encoder_delete(kduc_sequence_encoder* seq);
+
+/* starts a frame that is written to `target` and returns the compressor to
+   which its stripes are pushed */
+int kduc_sequence_encoder_start(kduc_sequence_encoder* seq,
+                                mem_compressed_target* target,
+                                kdu_stripe_compressor** enc);
+
+int kduc_sequence_encoder_finish(kduc_sequence_encoder* seq);
+
+/**
+ * kduc_sequence_decoder
+ */
+
+/**
+ * Decodes a sequence of codestreams that share the same main header. The
+ * codestream, its source and the decompressor are created for the first
+ * frame, and restarted for every subsequent frame without further heap
+ * allocation.
+ */
+int kduc_sequence_decoder_new(const kdu_stripe_decompressor_options* opts,
+                              kduc_sequence_decoder** out);
+
+void kduc_sequence_decoder_delete(kduc_sequence_decoder* seq);
+
+/* starts decoding the codestream held in `data`, which must remain valid until
+   kduc_sequence_decoder_finish(), and returns the codestream and the
+   decompressor from which its stripes are pulled */
+int kduc_sequence_decoder_start(kduc_sequence_decoder* seq,
+                                const unsigned char* data,
+                                unsigned long int len,
+                                kdu_codestream** cs,
+                                kdu_stripe_decompressor** dec);
+
+int kduc_sequence_decoder_finish(kduc_sequence_decoder* seq);
+
+/**
+ * kduc_encode_batch
+ */
+
+typedef struct kduc_encode_frame {
+  kdu_siz_params* siz;                /* geometry of the frame, which may be shared with other frames */
+  const char* const* params;          /* parsed as by kdu_codestream_parse_params(); may be NULL */
+  int param_count;
+  const kdu_stripe_compressor_options* opts;
+  kduc_sample_type sample_type;
+  void* planes[KDU_MAX_COMPONENT_COUNT]; /* one plane per component, each holding the entire component */
+  const int* row_gaps;                /* see kdu_stripe_compressor_push_stripe_planar(); may be NULL */
+  const int* precisions;              /* may be NULL */
+  const bool* is_signed;              /* ignored for KDUC_SAMPLE_8; may be NULL */
+  mem_compressed_target* target;
+  uint64_t frame_id;                  /* passed to the trace handler */
+  int result;                         /* set to 0 if the frame was encoded and 1 otherwise */
+} kduc_encode_frame;
+
+/**
+ * Encodes `frame_count` frames concurrently on `worker_count` threads,
+ * including the calling thread, with each frame using its own codestream and
+ * compressor. A worker encodes one frame at a time, so that at most
+ * `worker_count` frames are in flight. If `worker_count` is 0, one worker is
+ * used per processor.
+ *
+ * Parallelism comes from encoding frames concurrently, and `opts->thread_count`
+ * and `opts->pool` are therefore usually left unset.
+ *
+ * Returns 0 if every frame was encoded.
+ */
+int kduc_encode_batch(kduc_encode_frame* frames,
+                      int frame_count,
+                      int worker_count);
+
+/**
+ * kduc_async
+ */
+
+typedef struct kduc_decode_frame {
+  const unsigned char* data;          /* codestream, which must remain valid until the frame is decoded */
+  size_t size;
+  const kdu_stripe_decompressor_options* opts;
+  kduc_sample_type sample_type;
+  void* planes[KDU_MAX_COMPONENT_COUNT]; /* one plane per decoded component, each large enough to hold the entire component */
+  const int* row_gaps;                /* see kdu_stripe_decompressor_pull_stripe_planar(); may be NULL */
+  const int* precisions;              /* may be NULL */
+  const bool* is_signed;              /* ignored for KDUC_SAMPLE_8; may be NULL */
+  uint64_t frame_id;                  /* passed to the trace handler */
+  int result;                         /* set to 0 if the frame was decoded and 1 otherwise */
+} kduc_decode_frame;
+
+typedef struct kduc_completion {
+  void* user;                         /* value passed to kduc_async_submit_*() */
+  int result;                         /* `result` of the frame */
+} kduc_completion;
+
+/* called on the worker thread that completed the frame */
+typedef void (*kduc_completion_func)(const kduc_completion* completion);
+
+/**
+ * Encodes and decodes frames on `worker_count` background threads, so that
+ * the caller is never blocked by a frame. Frames are processed in submission
+ * order, and each frame and the buffers it references must remain valid
+ * until its completion is reported.
+ *
+ * Completions are reported by calling `callback`, which may for instance wake
+ * an event loop, or, if `callback` is NULL, are queued until retrieved by
+ * kduc_async_poll().
+ */
+int kduc_async_new(int worker_count,
+                   kduc_completion_func callback,
+                   kduc_async** out);
+
+/* waits for all submitted frames to complete */
+void kduc_async_delete(kduc_async* async);
+
+int kduc_async_submit_encode(kduc_async* async,
+                             kduc_encode_frame* frame,
+                             void* user);
+
+int kduc_async_submit_decode(kduc_async* async,
+                             kduc_decode_frame* frame,
+                             void* user);
+
+/* retrieves the oldest queued completion and returns 0, or returns 1 if there
+   is none. If `wait` is true, waits for a completion unless no frame is
+   outstanding. Completions are never queued if a callback is registered. */
+int kduc_async_poll(kduc_async* async, bool wait, kduc_completion* completion);
+
+/**
+ * kduc_decode_batch
+ */
+
+/**
+ * Decodes `frame_count` frames concurrently on `worker_count` threads,
+ * including the calling thread, or one thread per processor if `worker_count`
+ * is 0. Each worker reuses a single decompressor across the frames it decodes.
+ *
+ * The resolution reduction, region and components of each frame are set in
+ * its `opts`, e.g. `reduce` to decode thumbnails, and its planes must be large
+ * enough to hold the decoded components.
+ *
+ * A worker holds the `pool` of a frame's `opts`, if any, for as long as it
+ * decodes the frame, so frames that share a pool are decoded one after
+ * another (see kduc_thread_pool). To decode frames side by side with more than
+ * one thread each, set `thread_count` instead: each worker's decompressor then
+ * owns its threads and keeps them across frames.
+ *
+ * The `worker_count - 1` worker threads are started and joined by each call;
+ * kduc_async keeps its workers alive across frames.
+ *
+ * Returns 0 if every frame was decoded.
+ */
+int kduc_decode_batch(kduc_decode_frame* frames,
+                      int frame_count,
+                      int worker_count);
+
+/**
+ * kduc_encode_tiled
+ */
+
+/**
+ * Encodes an image, typically tiled using the `Stiles` parameter, from rows
+ * supplied by `reader`, so that the caller need not hold the whole image in
+ * memory. This is kdu_stripe_compressor_push_rows() with defaults suited to
+ * large tiled images: unless set in `opts`, `thread_count` defaults to the
+ * number of processors and `tile_concurrency` to the number of tiles across
+ * the image, so that all the tiles of a row of tiles are encoded concurrently.
+ *
+ * Memory is bounded per row of tiles rather than per tile: rows are read in
+ * stripes no taller than a tile, into sample buffers that span the width of
+ * the image, and Kakadu keeps the coding state of every tile of the row being
+ * encoded. The codestream is accumulated by the target of `cs`, unless `cs`
+ * was created using kdu_codestream_create_from_file_target().
+ */
+int kduc_encode_tiled(kdu_codestream* cs,
+                      const kdu_stripe_compressor_options* opts,
+                      kduc_sample_type sample_type,
+                      const int* precisions,
+                      const bool* is_signed,
+                      kduc_row_reader_func reader,
+                      void* user);
+
 /**
  * kdu_siz_params
  */
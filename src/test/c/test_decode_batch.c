@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2022, Sandflow Consulting LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <kduc.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define FRAME_COUNT 16
+
+void exit_with_error(const char* msg) {
+  printf("%s", msg);
+  fflush(stdout);
+  exit(-1);
+}
+
+int main(void) {
+  int height = 240;
+  int width = 320;
+  int num_comps = 3;
+  int ret;
+
+  unsigned char *pixels;
+  unsigned char *out_pixels[FRAME_COUNT];
+  kdu_siz_params *siz = NULL;
+  mem_compressed_target *targets[FRAME_COUNT];
+  kduc_encode_frame enc_frames[FRAME_COUNT];
+  kduc_decode_frame dec_frames[FRAME_COUNT];
+
+  /* register message handlers */
+
+  kdu_register_error_handler(&exit_with_error);
+  kdu_register_warning_handler(&exit_with_error);
+
+  /* create image */
+
+  pixels = malloc(height * width * num_comps);
+  if (! pixels)
+    return 1;
+
+  for(int i = 0; i < height * width * num_comps; i++)
+    pixels[i] = (unsigned char) (i & 0xFF);
+
+  /* encode frames */
+
+  ret = kdu_siz_params_new(&siz);
+  if (ret)
+    return ret;
+
+  kdu_siz_params_set_num_components(siz, num_comps);
+  kdu_siz_params_set_precision(siz, 0, 8);
+  kdu_siz_params_set_size(siz, 0, height, width);
+  kdu_siz_params_set_signed(siz, 0, 0);
+
+  kdu_stripe_compressor_options enc_opts;
+
+  kdu_stripe_compressor_options_init(&enc_opts);
+
+  for (int i = 0; i < FRAME_COUNT; i++) {
+    ret = kdu_compressed_target_mem_new(&targets[i]);
+    if (ret)
+      return ret;
+
+    enc_frames[i].siz = siz;
+    enc_frames[i].params = NULL;
+    enc_frames[i].param_count = 0;
+    enc_frames[i].opts = &enc_opts;
+    enc_frames[i].sample_type = KDUC_SAMPLE_8;
+    for (int c = 0; c < num_comps; c++)
+      enc_frames[i].planes[c] = pixels + c * height * width;
+    enc_frames[i].row_gaps = NULL;
+    enc_frames[i].precisions = NULL;
+    enc_frames[i].is_signed = NULL;
+    enc_frames[i].frame_id = i;
+    enc_frames[i].target = targets[i];
+  }
+
+  ret = kduc_encode_batch(enc_frames, FRAME_COUNT, 0);
+  if (ret)
+    return ret;
+
+  /* decode odd frames at full resolution and even frames at half resolution,
+     each worker keeping its own threads across frames */
+
+  kdu_stripe_decompressor_options full_opts;
+  kdu_stripe_decompressor_options half_opts;
+
+  kdu_stripe_decompressor_options_init(&full_opts);
+  kdu_stripe_decompressor_options_init(&half_opts);
+
+  full_opts.thread_count = 2;
+  half_opts.thread_count = 2;
+  half_opts.reduce = 1;
+
+  for (int i = 0; i < FRAME_COUNT; i++) {
+    unsigned char *buf;
+    int buf_sz;
+
+    kdu_compressed_target_bytes(targets[i], &buf, &buf_sz);
+
+    out_pixels[i] = malloc(height * width * num_comps);
+    if (! out_pixels[i])
+      return 1;
+
+    int reduce = (i % 2) ? 0 : 1;
+    int plane_size = (height >> reduce) * (width >> reduce);
+
+    dec_frames[i].data = buf;
+    dec_frames[i].size = buf_sz;
+    dec_frames[i].opts = reduce ? &half_opts : &full_opts;
+    dec_frames[i].sample_type = KDUC_SAMPLE_8;
+    for (int c = 0; c < num_comps; c++)
+      dec_frames[i].planes[c] = out_pixels[i] + c * plane_size;
+    dec_frames[i].row_gaps = NULL;
+    dec_frames[i].precisions = NULL;
+    dec_frames[i].is_signed = NULL;
+    dec_frames[i].frame_id = i;
+  }
+
+  ret = kduc_decode_batch(dec_frames, FRAME_COUNT, 4);
+  if (ret)
+    return ret;
+
+  for (int i = 0; i < FRAME_COUNT; i++) {
+    if (dec_frames[i].result)
+      return 1;
+
+    free(out_pixels[i]);
+
+    kdu_compressed_target_mem_delete(targets[i]);
+  }
+
+  kdu_siz_params_delete(siz);
+
+  free(pixels);
+
+  return 0;
+}
@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2022, Sandflow Consulting LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <kduc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* decodes `source` as restricted by `opts` into a buffer allocated in
+   `pixels`, and sets `size` to the size of the buffer */
+static int decode(kdu_compressed_source* source,
+                  const kdu_stripe_decompressor_options* opts,
+                  unsigned char** pixels,
+                  int* size) {
+  int height;
+  int width;
+  int num_comps;
+  int ret;
+  int sampling_x, sampling_y;
+
+  kdu_codestream *cs;
+  kdu_stripe_decompressor *d;
+
+  ret = kdu_codestream_create_from_source(source, &cs);
+  if (ret) return ret;
+
+  kdu_codestream_get_subsampling(cs, 0, &sampling_x, &sampling_y);
+  if (sampling_x != sampling_y || sampling_y != 1)
+    return 1;
+
+  ret = kdu_stripe_decompressor_new(&d);
+  if (ret) return ret;
+
+  ret = kdu_stripe_decompressor_start(d, cs, opts);
+  if (ret) return ret;
+
+  /* the size of the decoded image is known once the decompressor is started */
+
+  kdu_codestream_get_size(cs, 0, &height, &width);
+
+  num_comps = kdu_codestream_get_num_components(cs);
+
+  *size = width * height * num_comps;
+  *pixels = malloc(*size);
+  if (!*pixels) return 1;
+
+  int stripe_heights[4] = {height, height, height, height};
+  int precisions[4] = {8, 8, 8, 8};
+
+  int pull_strip_should_stop = 0;
+  while(!pull_strip_should_stop) {
+    pull_strip_should_stop = kdu_stripe_decompressor_pull_stripe(
+        d, *pixels, stripe_heights, NULL, NULL, NULL, precisions, NULL);
+  }
+
+  ret = kdu_stripe_decompressor_finish(d);
+  if (ret) return ret;
+
+  kdu_stripe_decompressor_delete(d);
+
+  kdu_codestream_delete(cs);
+
+  return 0;
+}
+
+int main(void) {
+  int ret;
+
+  kdu_compressed_source *source;
+  unsigned char *pixels;
+  int size;
+
+  kdu_stripe_decompressor_options opts;
+
+  kdu_stripe_decompressor_options_init(&opts);
+
+  /* full decode through the memory-mapped source */
+
+  ret = kdu_compressed_source_file_new("resources/counter-00000.j2c", &source);
+  if (ret) return ret;
+
+  ret = decode(source, &opts, &pixels, &size);
+  if (ret) return ret;
+
+  if (size != 640 * 360 * 3)
+    return 1;
+
+  free(pixels);
+
+  kdu_compressed_source_file_delete(source);
+
+  /* reduced region decode, which seeks to the packets it needs */
+
+  opts.reduce = 1;
+  opts.region_x = 100;
+  opts.region_y = 60;
+  opts.region_width = 200;
+  opts.region_height = 120;
+
+  ret = kdu_compressed_source_file_new("resources/counter-00000.j2c", &source);
+  if (ret) return ret;
+
+  ret = decode(source, &opts, &pixels, &size);
+  if (ret) return ret;
+
+  kdu_compressed_source_file_delete(source);
+
+  if (size != 100 * 60 * 3)
+    return 1;
+
+  /* the same decode from the file read into memory */
+
+  FILE *j2c_file = fopen("resources/counter-00000.j2c", "rb");
+  if (!j2c_file) return 1;
+
+  fseek(j2c_file, 0L, SEEK_END);
+  const long j2c_size = ftell(j2c_file);
+  fseek(j2c_file, 0L, SEEK_SET);
+
+  unsigned char *j2c_buffer = malloc(j2c_size);
+  if (!j2c_buffer) return 1;
+
+  if (fread(j2c_buffer, j2c_size, 1, j2c_file) != 1)
+    return 1;
+
+  fclose(j2c_file);
+
+  unsigned char *ref_pixels;
+  int ref_size;
+
+  ret = kdu_compressed_source_buffered_new(j2c_buffer, j2c_size, &source);
+  if (ret) return ret;
+
+  ret = decode(source, &opts, &ref_pixels, &ref_size);
+  if (ret) return ret;
+
+  kdu_compressed_source_buffered_delete(source);
+
+  if (ref_size != size || memcmp(ref_pixels, pixels, size))
+    return 1;
+
+  free(ref_pixels);
+
+  free(pixels);
+
+  free(j2c_buffer);
+
+  return 0;
+}
@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2022, Sandflow Consulting LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <kduc.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+int main(void) {
+  int height;
+  int width;
+  int ret;
+  unsigned char *y_pixels;
+
+  kdu_codestream* cs;
+  kdu_compressed_source* source;
+  kdu_stripe_decompressor* d;
+
+  FILE* j2c_file = fopen("resources/test.yuv.j2c", "rb");
+
+  fseek(j2c_file, 0L, SEEK_END);
+  const long size = ftell(j2c_file);
+  fseek(j2c_file, 0L, SEEK_SET);
+
+  unsigned char j2c_buffer[size];
+  fread(j2c_buffer, size, 1, j2c_file);
+
+  ret = kdu_compressed_source_buffered_new(&j2c_buffer[0], size, &source);
+  if (ret)
+    return ret;
+
+  ret = kdu_codestream_create_from_source(source, &cs);
+  if (ret)
+    return ret;
+
+  ret = kdu_stripe_decompressor_new(&d);
+  if (ret)
+    return ret;
+
+  /* the source is 640x480 4:2:0 */
+
+  int sampling_x;
+  int sampling_y;
+
+  if (kdu_codestream_get_num_components(cs) != 3)
+    return 1;
+
+  kdu_codestream_get_subsampling(cs, 1, &sampling_x, &sampling_y);
+  if (sampling_x != 2 || sampling_y != 2)
+    return 1;
+
+  /* decode the first quality layer of the luma component only */
+
+  kdu_stripe_decompressor_options opts;
+
+  kdu_stripe_decompressor_options_init(&opts);
+
+  opts.max_layers = 1;
+  opts.component_count = 1;
+  opts.components[0] = 0;
+
+  ret = kdu_stripe_decompressor_start(d, cs, &opts);
+  if (ret)
+    return ret;
+
+  if (kdu_codestream_get_num_components(cs) != 1)
+    return 1;
+
+  kdu_codestream_get_size(cs, 0, &height, &width);
+
+  /* the luma component is not subsampled */
+
+  if (height != 480 || width != 640)
+    return 1;
+
+  y_pixels = malloc(width * height);
+
+  if (!y_pixels)
+    return 1;
+
+  int stripe_heights[1] = {height};
+  int precisions[1] = {8};
+  unsigned char* pixels[1] = {y_pixels};
+
+  ret = kdu_stripe_decompressor_pull_stripe_planar(
+      d, pixels, stripe_heights, NULL, NULL, precisions, NULL);
+
+  /* the entire image is pulled as a single stripe */
+
+  if (! ret)
+    return 1;
+
+  ret = kdu_stripe_decompressor_finish(d);
+  if (ret)
+    return ret;
+
+  kdu_stripe_decompressor_delete(d);
+
+  kdu_codestream_delete(cs);
+
+  kdu_compressed_source_buffered_delete(source);
+
+  free(y_pixels);
+
+  return 0;
+}
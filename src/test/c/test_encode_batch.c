@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2022, Sandflow Consulting LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <kduc.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define FRAME_COUNT 16
+
+void exit_with_error(const char* msg) {
+  printf("%s", msg);
+  fflush(stdout);
+  exit(-1);
+}
+
+int main(void) {
+  int height = 240;
+  int width = 320;
+  int num_comps = 3;
+  int ret;
+
+  unsigned char *pixels;
+  kdu_siz_params *siz = NULL;
+  mem_compressed_target *targets[FRAME_COUNT];
+  kduc_encode_frame frames[FRAME_COUNT];
+
+  /* register message handlers */
+
+  kdu_register_error_handler(&exit_with_error);
+  kdu_register_warning_handler(&exit_with_error);
+
+  /* create one plane per component, shared by all frames */
+
+  pixels = malloc(height * width * num_comps);
+  if (! pixels)
+    return 1;
+
+  for(int i = 0; i < height * width * num_comps; i++)
+    pixels[i] = (unsigned char) (i & 0xFF);
+
+  /* initialize siz, which is shared by all frames */
+
+  ret = kdu_siz_params_new(&siz);
+  if (ret)
+    return ret;
+
+  kdu_siz_params_set_num_components(siz, num_comps);
+  kdu_siz_params_set_precision(siz, 0, 8);
+  kdu_siz_params_set_size(siz, 0, height, width);
+  kdu_siz_params_set_signed(siz, 0, 0);
+
+  kdu_stripe_compressor_options opts;
+
+  kdu_stripe_compressor_options_init(&opts);
+
+  const char *params[1] = {"Clevels=3"};
+
+  for (int i = 0; i < FRAME_COUNT; i++) {
+    ret = kdu_compressed_target_mem_new(&targets[i]);
+    if (ret)
+      return ret;
+
+    frames[i].siz = siz;
+    frames[i].params = params;
+    frames[i].param_count = 1;
+    frames[i].opts = &opts;
+    frames[i].sample_type = KDUC_SAMPLE_8;
+    for (int c = 0; c < num_comps; c++)
+      frames[i].planes[c] = pixels + c * height * width;
+    frames[i].row_gaps = NULL;
+    frames[i].precisions = NULL;
+    frames[i].is_signed = NULL;
+    frames[i].frame_id = i;
+    frames[i].target = targets[i];
+  }
+
+  /* encode */
+
+  ret = kduc_encode_batch(frames, FRAME_COUNT, 4);
+  if (ret)
+    return ret;
+
+  /* all frames are identical */
+
+  unsigned char *first_buf;
+  int first_sz;
+
+  kdu_compressed_target_bytes(targets[0], &first_buf, &first_sz);
+
+  if (first_sz == 0)
+    return 1;
+
+  for (int i = 0; i < FRAME_COUNT; i++) {
+    unsigned char *buf;
+    int buf_sz;
+
+    if (frames[i].result)
+      return 1;
+
+    kdu_compressed_target_bytes(targets[i], &buf, &buf_sz);
+
+    if (buf_sz != first_sz)
+      return 1;
+
+    kdu_compressed_target_mem_delete(targets[i]);
+  }
+
+  kdu_siz_params_delete(siz);
+
+  free(pixels);
+
+  return 0;
+}
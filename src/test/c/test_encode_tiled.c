@@ -0,0 +1,192 @@
+/*
+ * Copyright (c) 2022, Sandflow Consulting LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <kduc.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static int width = 1024;
+
+static unsigned char sample_at(int comp_idx, int x, int y) {
+  return (unsigned char) ((x + 3 * y + 50 * comp_idx) & 0xFF);
+}
+
+void exit_with_error(const char* msg) {
+  printf("%s", msg);
+  fflush(stdout);
+  exit(-1);
+}
+
+int read_rows(void* user, int comp_idx, int first_row, int row_count,
+              int row_width, void* samples) {
+  unsigned char *rows = samples;
+
+  if (row_width != width)
+    return 1;
+
+  for (int y = 0; y < row_count; y++)
+    for (int x = 0; x < row_width; x++)
+      rows[y * row_width + x] = sample_at(comp_idx, x, first_row + y);
+
+  *(int*)user += row_count;
+
+  return 0;
+}
+
+int write_rows(void* user, int comp_idx, int first_row, int row_count,
+               int row_width, const void* samples) {
+  const unsigned char *rows = samples;
+
+  for (int y = 0; y < row_count; y++)
+    for (int x = 0; x < row_width; x++)
+      if (rows[y * row_width + x] != sample_at(comp_idx, x, first_row + y))
+        return 1;
+
+  *(int*)user += row_count;
+
+  return 0;
+}
+
+int main(void) {
+  int height = 768;
+  int num_comps = 3;
+  int ret;
+
+  mem_compressed_target *target = NULL;
+  kdu_codestream *cs = NULL;
+  kdu_siz_params *siz = NULL;
+  kdu_compressed_source *source = NULL;
+  kdu_stripe_decompressor *dec = NULL;
+
+  unsigned char *buf;
+  int buf_sz;
+  int row_count;
+
+  /* register message handlers */
+
+  kdu_register_error_handler(&exit_with_error);
+  kdu_register_warning_handler(&exit_with_error);
+
+  /* initialize siz */
+
+  ret = kdu_siz_params_new(&siz);
+  if (ret)
+    return ret;
+
+  kdu_siz_params_set_num_components(siz, num_comps);
+  kdu_siz_params_set_precision(siz, 0, 8);
+  kdu_siz_params_set_size(siz, 0, height, width);
+  kdu_siz_params_set_signed(siz, 0, 0);
+
+  ret = kdu_siz_params_parse_string(siz, "Stiles={256,256}");
+  if (ret)
+    return ret;
+
+  /* encode losslessly, one row of tiles at a time */
+
+  ret = kdu_compressed_target_mem_new(&target);
+  if (ret)
+    return ret;
+
+  ret = kdu_codestream_create_from_target(target, siz, &cs);
+  if (ret)
+    return ret;
+
+  ret = kdu_codestream_parse_params(cs, "Creversible=yes");
+  if (ret)
+    return ret;
+
+  kdu_stripe_compressor_options enc_opts;
+
+  kdu_stripe_compressor_options_init(&enc_opts);
+
+  enc_opts.thread_count = 4;
+
+  row_count = 0;
+
+  ret = kduc_encode_tiled(cs, &enc_opts, KDUC_SAMPLE_8, NULL, NULL, &read_rows,
+                          &row_count);
+  if (ret)
+    return ret;
+
+  if (row_count != height * num_comps)
+    return 1;
+
+  kdu_codestream_delete(cs);
+
+  kdu_compressed_target_bytes(target, &buf, &buf_sz);
+
+  if (buf_sz == 0)
+    return 1;
+
+  /* decode, checking each stripe as it is written */
+
+  ret = kdu_compressed_source_buffered_new(buf, buf_sz, &source);
+  if (ret)
+    return ret;
+
+  ret = kdu_codestream_create_from_source(source, &cs);
+  if (ret)
+    return ret;
+
+  ret = kdu_stripe_decompressor_new(&dec);
+  if (ret)
+    return ret;
+
+  kdu_stripe_decompressor_options dec_opts;
+
+  kdu_stripe_decompressor_options_init(&dec_opts);
+
+  ret = kdu_stripe_decompressor_start(dec, cs, &dec_opts);
+  if (ret)
+    return ret;
+
+  row_count = 0;
+
+  ret = kdu_stripe_decompressor_pull_rows(dec, cs, KDUC_SAMPLE_8, NULL, NULL, 64,
+                                          &write_rows, &row_count);
+  if (ret)
+    return ret;
+
+  if (row_count != height * num_comps)
+    return 1;
+
+  ret = kdu_stripe_decompressor_finish(dec);
+  if (ret)
+    return ret;
+
+  kdu_stripe_decompressor_delete(dec);
+
+  kdu_codestream_delete(cs);
+
+  kdu_compressed_source_buffered_delete(source);
+
+  kdu_compressed_target_mem_delete(target);
+
+  kdu_siz_params_delete(siz);
+
+  return 0;
+}
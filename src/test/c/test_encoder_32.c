@@ -0,0 +1,193 @@
+/*
+ * Copyright (c) 2022, Sandflow Consulting LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <kduc.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+void print_message(const char* msg) {
+  printf("%s", msg);
+  fflush(stdout);
+}
+
+void exit_with_error(const char* msg) {
+  printf("%s", msg);
+  fflush(stdout);
+  exit(-1);
+}
+
+int main(void) {
+  int height = 480;
+  int width = 640;
+  int precision = 20;
+  int ret;
+
+  int32_t *pixels;
+  int32_t *decoded;
+  mem_compressed_target *target = NULL;
+  kdu_codestream *cs = NULL;
+  kdu_stripe_compressor *enc = NULL;
+  kdu_siz_params *siz = NULL;
+  kdu_compressed_source *source = NULL;
+  kdu_stripe_decompressor *dec = NULL;
+
+  unsigned char *buf;
+  int buf_sz;
+
+  /* register message handlers */
+
+  kdu_register_error_handler(&exit_with_error);
+  kdu_register_warning_handler(&exit_with_error);
+  kdu_register_info_handler(&print_message);
+
+  /* create a single-component image that uses all 20 bits */
+
+  pixels = malloc(height * width * sizeof(*pixels));
+  decoded = malloc(height * width * sizeof(*decoded));
+  if (! (pixels && decoded))
+    return 1;
+
+  for(int i = 0; i < height * width; i++)
+    pixels[i] = (i * 37) & ((1 << precision) - 1);
+
+  /* initialize siz */
+
+  ret = kdu_siz_params_new(&siz);
+  if (ret)
+    return ret;
+
+  kdu_siz_params_set_num_components(siz, 1);
+  kdu_siz_params_set_precision(siz, 0, precision);
+  kdu_siz_params_set_size(siz, 0, height, width);
+  kdu_siz_params_set_signed(siz, 0, 0);
+
+  /* encode losslessly */
+
+  ret = kdu_compressed_target_mem_new(&target);
+  if (ret)
+    return ret;
+
+  ret = kdu_codestream_create_from_target(target, siz, &cs);
+  if (ret)
+    return ret;
+
+  ret = kdu_codestream_parse_params(cs, "Creversible=yes");
+  if (ret)
+    return ret;
+
+  ret = kdu_stripe_compressor_new(&enc);
+  if (ret)
+    return ret;
+
+  kdu_stripe_compressor_options enc_opts;
+
+  kdu_stripe_compressor_options_init(&enc_opts);
+
+  int stripe_heights[1] = {height};
+  int precisions[1] = {precision};
+  bool is_signed[1] = {false};
+
+  ret = kdu_stripe_compressor_start(enc, cs, &enc_opts);
+  if (ret)
+    return ret;
+
+  int stop = 0;
+  while (!stop) {
+    stop = kdu_stripe_compressor_push_stripe_32(
+        enc, pixels, stripe_heights, NULL, NULL, NULL, precisions, is_signed);
+  }
+
+  ret = kdu_stripe_compressor_finish(enc);
+  if (ret)
+    return ret;
+
+  kdu_stripe_compressor_delete(enc);
+
+  kdu_codestream_delete(cs);
+
+  kdu_compressed_target_bytes(target, &buf, &buf_sz);
+
+  if (buf_sz == 0)
+    return 1;
+
+  /* decode */
+
+  ret = kdu_compressed_source_buffered_new(buf, buf_sz, &source);
+  if (ret)
+    return ret;
+
+  ret = kdu_codestream_create_from_source(source, &cs);
+  if (ret)
+    return ret;
+
+  if (kdu_codestream_get_depth(cs, 0) != precision)
+    return 1;
+
+  ret = kdu_stripe_decompressor_new(&dec);
+  if (ret)
+    return ret;
+
+  kdu_stripe_decompressor_options dec_opts;
+
+  kdu_stripe_decompressor_options_init(&dec_opts);
+
+  ret = kdu_stripe_decompressor_start(dec, cs, &dec_opts);
+  if (ret)
+    return ret;
+
+  int32_t *planes[1] = {decoded};
+
+  stop = 0;
+  while (!stop) {
+    stop = kdu_stripe_decompressor_pull_stripe_planar_32(
+        dec, planes, stripe_heights, NULL, NULL, precisions, is_signed, NULL);
+  }
+
+  ret = kdu_stripe_decompressor_finish(dec);
+  if (ret)
+    return ret;
+
+  for (int i = 0; i < height * width; i++) {
+    if (decoded[i] != pixels[i])
+      return 1;
+  }
+
+  kdu_stripe_decompressor_delete(dec);
+
+  kdu_codestream_delete(cs);
+
+  kdu_compressed_source_buffered_delete(source);
+
+  kdu_compressed_target_mem_delete(target);
+
+  kdu_siz_params_delete(siz);
+
+  free(pixels);
+
+  free(decoded);
+
+  return 0;
+}
@@ -0,0 +1,283 @@
+/*
+ * Copyright (c) 2022, Sandflow Consulting LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <kduc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+static int height = 480;
+static int width = 640;
+static int num_comps = 3;
+
+void print_message(const char* msg) {
+  printf("%s", msg);
+  fflush(stdout);
+}
+
+void exit_with_error(const char* msg) {
+  printf("%s", msg);
+  fflush(stdout);
+  exit(-1);
+}
+
+/* encodes `pixels` into `cs`, with TLM markers that are rewritten once the
+   codestream is flushed */
+static int encode(kdu_codestream* cs, unsigned char* pixels) {
+  kdu_stripe_compressor *enc = NULL;
+  int ret;
+
+  ret = kdu_codestream_parse_params(cs, "Ctype=N");
+  if (ret)
+    return ret;
+
+  ret = kdu_codestream_parse_params(cs, "Qweights=1.732051,1.805108,1.573402");
+  if (ret)
+    return ret;
+
+  ret = kdu_codestream_parse_params(cs, "Qfactor=85");
+  if (ret)
+    return ret;
+
+  ret = kdu_codestream_parse_params(cs, "Corder=CPRL");
+  if (ret)
+    return ret;
+
+  ret = kdu_codestream_parse_params(cs, "ORGtparts=C");
+  if (ret)
+    return ret;
+
+  ret = kdu_codestream_parse_params(cs, "ORGgen_tlm=3");
+  if (ret)
+    return ret;
+
+  ret = kdu_stripe_compressor_new(&enc);
+  if (ret)
+    return ret;
+
+  kdu_stripe_compressor_options opts;
+
+  kdu_stripe_compressor_options_init(&opts);
+
+  int stripe_heights[3] = {height, height, height};
+  int precisions[3] = {8, 8, 8};
+
+  ret = kdu_stripe_compressor_start(enc, cs, &opts);
+  if (ret)
+    return ret;
+
+  int stop = 0;
+  while (!stop) {
+    stop = kdu_stripe_compressor_push_stripe(enc, pixels, stripe_heights, NULL,
+                                             NULL, NULL, precisions);
+  }
+
+  ret = kdu_stripe_compressor_finish(enc);
+  if (ret)
+    return ret;
+
+  kdu_stripe_compressor_delete(enc);
+
+  return 0;
+}
+
+int main(void) {
+  int ret;
+
+  unsigned char *pixels;
+  mem_compressed_target *mem_target = NULL;
+  file_compressed_target *target = NULL;
+  kdu_codestream *cs = NULL;
+  kdu_siz_params *siz = NULL;
+  kdu_compressed_source *source = NULL;
+  kdu_stripe_decompressor *dec = NULL;
+
+  unsigned char *mem_buf;
+  int mem_buf_sz;
+
+  /* register message handlers */
+
+  kdu_register_error_handler(&exit_with_error);
+  kdu_register_warning_handler(&exit_with_error);
+  kdu_register_info_handler(&print_message);
+
+  /* create image */
+
+  pixels = malloc(height * width * num_comps);
+  if (! pixels)
+    return 1;
+
+  for(int i = 0; i < height * width * num_comps; i++)
+    pixels[i] = (unsigned char) (i & 0xFF);
+
+  /* initialize siz */
+
+  ret = kdu_siz_params_new(&siz);
+  if (ret)
+    return ret;
+
+  kdu_siz_params_set_num_components(siz, num_comps);
+  kdu_siz_params_set_precision(siz, 0, 8);
+  kdu_siz_params_set_size(siz, 0, height, width);
+  kdu_siz_params_set_signed(siz, 0, 0);
+
+  /* reference encode to memory */
+
+  ret = kdu_compressed_target_mem_new(&mem_target);
+  if (ret)
+    return ret;
+
+  ret = kdu_codestream_create_from_target(mem_target, siz, &cs);
+  if (ret)
+    return ret;
+
+  ret = encode(cs, pixels);
+  if (ret)
+    return ret;
+
+  kdu_codestream_delete(cs);
+
+  kdu_compressed_target_bytes(mem_target, &mem_buf, &mem_buf_sz);
+
+  /* the TLM markers in the main header are rewritten once the codestream is
+     flushed, by which time the first 4096-byte block has been written to the
+     file */
+
+  if (mem_buf_sz <= 4096)
+    return 1;
+
+  /* allocate output codestream, readable since direct rewrites read back the
+     sectors they modify */
+
+  int fd = open("test_encoder_file.j2c", O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    return 1;
+
+  int fd_flags = fcntl(fd, F_GETFL);
+
+  kdu_compressed_target_file_options target_opts;
+
+  kdu_compressed_target_file_options_init(&target_opts);
+
+  target_opts.block_size = 4096;
+  target_opts.direct = true;
+
+  ret = kdu_compressed_target_file_new(fd, &target_opts, &target);
+  if (ret)
+    return ret;
+
+  ret = kdu_codestream_create_from_file_target(target, siz, &cs);
+  if (ret)
+    return ret;
+
+  ret = encode(cs, pixels);
+  if (ret)
+    return ret;
+
+  kdu_codestream_textualize_params(cs, &print_message);
+
+  ret = kdu_compressed_target_file_close(target);
+  if (ret)
+    return ret;
+
+  kdu_codestream_delete(cs);
+
+  kdu_compressed_target_file_delete(target);
+
+  /* the descriptor is handed back without `O_DIRECT` */
+
+  if (fcntl(fd, F_GETFL) != fd_flags)
+    return 1;
+
+  /* the file matches the reference byte for byte, including the padded and
+     then truncated last block */
+
+  if (lseek(fd, 0, SEEK_END) != mem_buf_sz)
+    return 1;
+
+  unsigned char *file_buf = malloc(mem_buf_sz);
+  if (! file_buf)
+    return 1;
+
+  if (lseek(fd, 0, SEEK_SET) != 0 || read(fd, file_buf, mem_buf_sz) != mem_buf_sz)
+    return 1;
+
+  if (memcmp(file_buf, mem_buf, mem_buf_sz))
+    return 1;
+
+  free(file_buf);
+
+  close(fd);
+
+  /* the file decodes */
+
+  ret = kdu_compressed_source_file_new("test_encoder_file.j2c", &source);
+  if (ret)
+    return ret;
+
+  ret = kdu_codestream_create_from_source(source, &cs);
+  if (ret)
+    return ret;
+
+  ret = kdu_stripe_decompressor_new(&dec);
+  if (ret)
+    return ret;
+
+  kdu_stripe_decompressor_options dec_opts;
+
+  kdu_stripe_decompressor_options_init(&dec_opts);
+
+  ret = kdu_stripe_decompressor_start(dec, cs, &dec_opts);
+  if (ret)
+    return ret;
+
+  int stripe_heights[3] = {height, height, height};
+  int precisions[3] = {8, 8, 8};
+
+  if (! kdu_stripe_decompressor_pull_stripe(dec, pixels, stripe_heights, NULL,
+                                            NULL, NULL, precisions, NULL))
+    return 1;
+
+  ret = kdu_stripe_decompressor_finish(dec);
+  if (ret)
+    return ret;
+
+  kdu_stripe_decompressor_delete(dec);
+
+  kdu_codestream_delete(cs);
+
+  kdu_compressed_source_file_delete(source);
+
+  kdu_compressed_target_mem_delete(mem_target);
+
+  kdu_siz_params_delete(siz);
+
+  free(pixels);
+
+  return 0;
+}
@@ -0,0 +1,247 @@
+/*
+ * Copyright (c) 2022, Sandflow Consulting LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <kduc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+void exit_with_error(const char* msg) {
+  printf("%s", msg);
+  fflush(stdout);
+  exit(-1);
+}
+
+/* returns the code-block style byte (Cmodes) of the COD marker in the main
+   header of the codestream in `buf`, or -1 if there is none */
+static int get_block_style(const unsigned char* buf, int buf_sz) {
+  int pos = 2;
+
+  while (pos + 4 <= buf_sz) {
+    int marker = (buf[pos] << 8) | buf[pos + 1];
+    int len = (buf[pos + 2] << 8) | buf[pos + 3];
+
+    if (marker == 0xFF90)
+      break;
+
+    /* Lcod, Scod, SGcod and then the decomposition levels and code-block
+       dimensions of SPcod precede the code-block style */
+
+    if (marker == 0xFF52)
+      return pos + 12 < buf_sz ? buf[pos + 12] : -1;
+
+    pos += 2 + len;
+  }
+
+  return -1;
+}
+
+/* encodes and then decodes `pixels` using `block_coder` */
+static int round_trip(kdu_block_coder block_coder,
+                      const char* name,
+                      unsigned char* pixels,
+                      int height,
+                      int width) {
+  int ret;
+
+  mem_compressed_target *target = NULL;
+  kdu_codestream *cs = NULL;
+  kdu_stripe_compressor *enc = NULL;
+  kdu_siz_params *siz = NULL;
+  kdu_compressed_source *source = NULL;
+  kdu_stripe_decompressor *dec = NULL;
+
+  unsigned char *buf;
+  int buf_sz;
+
+  int stripe_heights[3] = {height, height, height};
+  int precisions[3] = {8, 8, 8};
+
+  /* encode */
+
+  clock_t start = clock();
+
+  ret = kdu_siz_params_new(&siz);
+  if (ret)
+    return ret;
+
+  kdu_siz_params_set_num_components(siz, 3);
+  kdu_siz_params_set_precision(siz, 0, 8);
+  kdu_siz_params_set_size(siz, 0, height, width);
+  kdu_siz_params_set_signed(siz, 0, 0);
+
+  ret = kdu_compressed_target_mem_new(&target);
+  if (ret)
+    return ret;
+
+  ret = kdu_codestream_create_from_target(target, siz, &cs);
+  if (ret)
+    return ret;
+
+  ret = kdu_codestream_parse_params(cs, "Qfactor=85");
+  if (ret)
+    return ret;
+
+  ret = kdu_stripe_compressor_new(&enc);
+  if (ret)
+    return ret;
+
+  kdu_stripe_compressor_options enc_opts;
+
+  kdu_stripe_compressor_options_init(&enc_opts);
+
+  enc_opts.block_coder = block_coder;
+
+  ret = kdu_stripe_compressor_start(enc, cs, &enc_opts);
+  if (ret)
+    return ret;
+
+  int stop = 0;
+  while (!stop) {
+    stop = kdu_stripe_compressor_push_stripe(enc, pixels, stripe_heights, NULL,
+                                             NULL, NULL, precisions);
+  }
+
+  ret = kdu_stripe_compressor_finish(enc);
+  if (ret)
+    return ret;
+
+  kdu_stripe_compressor_delete(enc);
+
+  kdu_codestream_delete(cs);
+
+  kdu_siz_params_delete(siz);
+
+  clock_t encode_end = clock();
+
+  kdu_compressed_target_bytes(target, &buf, &buf_sz);
+
+  if (buf_sz == 0)
+    return 1;
+
+  /* check that the requested block coder is signaled */
+
+  int block_style = get_block_style(buf, buf_sz);
+
+  if (block_style < 0)
+    return 1;
+
+  if (block_coder == KDU_BLOCK_CODER_LEGACY && (block_style & 0xC0) != 0)
+    return 1;
+
+  if (block_coder == KDU_BLOCK_CODER_HT && (block_style & 0xC0) != 0x40)
+    return 1;
+
+  if (block_coder == KDU_BLOCK_CODER_HT_MIXED && (block_style & 0xC0) != 0xC0)
+    return 1;
+
+  /* decode */
+
+  ret = kdu_compressed_source_buffered_new(buf, buf_sz, &source);
+  if (ret)
+    return ret;
+
+  ret = kdu_codestream_create_from_source(source, &cs);
+  if (ret)
+    return ret;
+
+  ret = kdu_stripe_decompressor_new(&dec);
+  if (ret)
+    return ret;
+
+  kdu_stripe_decompressor_options dec_opts;
+
+  kdu_stripe_decompressor_options_init(&dec_opts);
+
+  ret = kdu_stripe_decompressor_start(dec, cs, &dec_opts);
+  if (ret)
+    return ret;
+
+  stop = 0;
+  while (!stop) {
+    stop = kdu_stripe_decompressor_pull_stripe(
+        dec, pixels, stripe_heights, NULL, NULL, NULL, precisions, NULL);
+  }
+
+  ret = kdu_stripe_decompressor_finish(dec);
+  if (ret)
+    return ret;
+
+  kdu_stripe_decompressor_delete(dec);
+
+  kdu_codestream_delete(cs);
+
+  kdu_compressed_source_buffered_delete(source);
+
+  clock_t decode_end = clock();
+
+  printf("%s: %d bytes, encode %.1f ms, decode %.1f ms\n", name, buf_sz,
+         (encode_end - start) * 1000.0 / CLOCKS_PER_SEC,
+         (decode_end - encode_end) * 1000.0 / CLOCKS_PER_SEC);
+
+  kdu_compressed_target_mem_delete(target);
+
+  return 0;
+}
+
+int main(void) {
+  int height = 1080;
+  int width = 1920;
+  int num_comps = 3;
+  int ret;
+
+  unsigned char *pixels;
+
+  /* register message handlers */
+
+  kdu_register_error_handler(&exit_with_error);
+  kdu_register_warning_handler(&exit_with_error);
+
+  /* create image */
+
+  pixels = malloc(height * width * num_comps);
+  if (! pixels)
+    return 1;
+
+  for(int i = 0; i < height * width * num_comps; i++)
+    pixels[i] = (unsigned char) (i & 0xFF);
+
+  ret = round_trip(KDU_BLOCK_CODER_LEGACY, "legacy", pixels, height, width);
+  if (ret)
+    return ret;
+
+  ret = round_trip(KDU_BLOCK_CODER_HT, "HT", pixels, height, width);
+  if (ret)
+    return ret;
+
+  ret = round_trip(KDU_BLOCK_CODER_HT_MIXED, "HT mixed", pixels, height, width);
+  if (ret)
+    return ret;
+
+  free(pixels);
+
+  return 0;
+}
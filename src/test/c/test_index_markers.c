@@ -0,0 +1,309 @@
+/*
+ * Copyright (c) 2022, Sandflow Consulting LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <kduc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int width = 1024;
+static int height = 768;
+static int num_comps = 3;
+
+/* a region much smaller than the 256x256 tile at (1, 1) that contains it */
+static int region_x = 320;
+static int region_y = 320;
+static int region_size = 64;
+
+typedef struct mem_reader {
+  const unsigned char *buf;
+  int64_t size;
+  int64_t pos;
+  int64_t bytes_read;
+} mem_reader;
+
+static unsigned char sample_at(int comp_idx, int x, int y) {
+  return (unsigned char) ((x + 3 * y + 50 * comp_idx) & 0xFF);
+}
+
+void exit_with_error(const char* msg) {
+  printf("%s", msg);
+  fflush(stdout);
+  exit(-1);
+}
+
+int mem_read(void* user, unsigned char* buf, int num_bytes) {
+  mem_reader *reader = user;
+  int64_t remaining = reader->size - reader->pos;
+
+  if (num_bytes > remaining)
+    num_bytes = (int) remaining;
+
+  memcpy(buf, reader->buf + reader->pos, num_bytes);
+  reader->pos += num_bytes;
+  reader->bytes_read += num_bytes;
+
+  return num_bytes;
+}
+
+bool mem_seek(void* user, int64_t offset) {
+  mem_reader *reader = user;
+
+  if (offset < 0 || offset > reader->size)
+    return false;
+
+  reader->pos = offset;
+
+  return true;
+}
+
+int64_t mem_get_pos(void* user) {
+  return ((mem_reader*)user)->pos;
+}
+
+int read_rows(void* user, int comp_idx, int first_row, int row_count,
+              int row_width, void* samples) {
+  unsigned char *rows = samples;
+
+  for (int y = 0; y < row_count; y++)
+    for (int x = 0; x < row_width; x++)
+      rows[y * row_width + x] = sample_at(comp_idx, x, first_row + y);
+
+  return 0;
+}
+
+int write_rows(void* user, int comp_idx, int first_row, int row_count,
+               int row_width, const void* samples) {
+  const unsigned char *rows = samples;
+
+  if (row_width != region_size)
+    return 1;
+
+  for (int y = 0; y < row_count; y++)
+    for (int x = 0; x < row_width; x++)
+      if (rows[y * row_width + x] !=
+          sample_at(comp_idx, region_x + x, region_y + first_row + y))
+        return 1;
+
+  *(int*)user += row_count;
+
+  return 0;
+}
+
+/* encodes the test image losslessly into `target`, with TLM and PLT markers if
+   `is_indexed` */
+static int encode(kdu_siz_params* siz, bool is_indexed,
+                  mem_compressed_target** target) {
+  kdu_codestream *cs = NULL;
+  int ret;
+
+  ret = kdu_compressed_target_mem_new(target);
+  if (ret)
+    return ret;
+
+  ret = kdu_codestream_create_from_target(*target, siz, &cs);
+  if (ret)
+    return ret;
+
+  ret = kdu_codestream_parse_params(cs, "Creversible=yes");
+  if (ret)
+    return ret;
+
+  ret = kdu_codestream_parse_params(cs, "Cprecincts={64,64}");
+  if (ret)
+    return ret;
+
+  kdu_stripe_compressor_options enc_opts;
+
+  kdu_stripe_compressor_options_init(&enc_opts);
+
+  if (is_indexed) {
+    enc_opts.gen_tlm = 1;
+    enc_opts.gen_plt = true;
+  }
+
+  ret = kduc_encode_tiled(cs, &enc_opts, KDUC_SAMPLE_8, NULL, NULL, &read_rows,
+                          NULL);
+  if (ret)
+    return ret;
+
+  kdu_codestream_delete(cs);
+
+  return 0;
+}
+
+/* decodes the region from a seekable source over `buf` and sets `bytes_read`
+   to the number of bytes read from it */
+static int decode_region(unsigned char* buf, int buf_sz, int64_t* bytes_read) {
+  kdu_codestream *cs = NULL;
+  kdu_compressed_source *source = NULL;
+  kdu_stripe_decompressor *dec = NULL;
+  int row_count;
+  int ret;
+
+  mem_reader reader = {buf, buf_sz, 0, 0};
+
+  kdu_compressed_source_callbacks callbacks = {&mem_read, &mem_seek,
+                                               &mem_get_pos, NULL};
+
+  ret = kdu_compressed_source_callback_new(&callbacks, &reader, &source);
+  if (ret)
+    return ret;
+
+  ret = kdu_codestream_create_from_source(source, &cs);
+  if (ret)
+    return ret;
+
+  ret = kdu_stripe_decompressor_new(&dec);
+  if (ret)
+    return ret;
+
+  kdu_stripe_decompressor_options dec_opts;
+
+  kdu_stripe_decompressor_options_init(&dec_opts);
+
+  dec_opts.region_x = region_x;
+  dec_opts.region_y = region_y;
+  dec_opts.region_width = region_size;
+  dec_opts.region_height = region_size;
+
+  ret = kdu_stripe_decompressor_start(dec, cs, &dec_opts);
+  if (ret)
+    return ret;
+
+  row_count = 0;
+
+  ret = kdu_stripe_decompressor_pull_rows(dec, cs, KDUC_SAMPLE_8, NULL, NULL, 64,
+                                          &write_rows, &row_count);
+  if (ret)
+    return ret;
+
+  if (row_count != region_size * num_comps)
+    return 1;
+
+  ret = kdu_stripe_decompressor_finish(dec);
+  if (ret)
+    return ret;
+
+  kdu_stripe_decompressor_delete(dec);
+
+  kdu_codestream_delete(cs);
+
+  kdu_compressed_source_callback_delete(source);
+
+  *bytes_read = reader.bytes_read;
+
+  return 0;
+}
+
+int main(void) {
+  int ret;
+
+  kdu_siz_params *siz = NULL;
+  mem_compressed_target *plain_target = NULL;
+  mem_compressed_target *indexed_target = NULL;
+
+  unsigned char *buf;
+  int buf_sz;
+  int64_t plain_bytes_read;
+  int64_t indexed_bytes_read;
+  kduc_info info;
+
+  /* register message handlers */
+
+  kdu_register_error_handler(&exit_with_error);
+  kdu_register_warning_handler(&exit_with_error);
+
+  /* initialize siz */
+
+  ret = kdu_siz_params_new(&siz);
+  if (ret)
+    return ret;
+
+  kdu_siz_params_set_num_components(siz, num_comps);
+  kdu_siz_params_set_precision(siz, 0, 8);
+  kdu_siz_params_set_size(siz, 0, height, width);
+  kdu_siz_params_set_signed(siz, 0, 0);
+
+  ret = kdu_siz_params_parse_string(siz, "Stiles={256,256}");
+  if (ret)
+    return ret;
+
+  /* without index markers */
+
+  ret = encode(siz, false, &plain_target);
+  if (ret)
+    return ret;
+
+  kdu_compressed_target_bytes(plain_target, &buf, &buf_sz);
+
+  ret = kduc_probe(buf, buf_sz, &info);
+  if (ret)
+    return ret;
+
+  if (info.has_tlm)
+    return 1;
+
+  ret = decode_region(buf, buf_sz, &plain_bytes_read);
+  if (ret)
+    return ret;
+
+  /* with TLM and PLT markers */
+
+  ret = encode(siz, true, &indexed_target);
+  if (ret)
+    return ret;
+
+  kdu_compressed_target_bytes(indexed_target, &buf, &buf_sz);
+
+  ret = kduc_probe(buf, buf_sz, &info);
+  if (ret)
+    return ret;
+
+  if (!info.has_tlm || info.num_tiles != 12)
+    return 1;
+
+  ret = decode_region(buf, buf_sz, &indexed_bytes_read);
+  if (ret)
+    return ret;
+
+  /* the markers locate the tile and the precincts of the region, whereas
+     tile-part and packet headers are otherwise read to skip the rest */
+
+  printf("bytes read: %lld without index markers, %lld with\n",
+         (long long) plain_bytes_read, (long long) indexed_bytes_read);
+
+  if (indexed_bytes_read >= plain_bytes_read)
+    return 1;
+
+  kdu_compressed_target_mem_delete(plain_target);
+
+  kdu_compressed_target_mem_delete(indexed_target);
+
+  kdu_siz_params_delete(siz);
+
+  return 0;
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2022, Sandflow Consulting LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <kduc.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static unsigned char* read_file(const char* path, long* size) {
+  FILE *j2c_file = fopen(path, "rb");
+  if (!j2c_file) return NULL;
+
+  fseek(j2c_file, 0L, SEEK_END);
+  *size = ftell(j2c_file);
+  fseek(j2c_file, 0L, SEEK_SET);
+
+  unsigned char *j2c_buffer = malloc(*size);
+  if (j2c_buffer)
+    fread(j2c_buffer, *size, 1, j2c_file);
+
+  fclose(j2c_file);
+
+  return j2c_buffer;
+}
+
+int main(void) {
+  kduc_info info;
+  unsigned char *buf;
+  long size;
+
+  /* 4:4:4 16-bit codestream */
+
+  buf = read_file("resources/counter-00000.j2c", &size);
+  if (!buf) return 1;
+
+  if (kduc_probe(buf, size, &info))
+    return 1;
+
+  if (info.width != 640 || info.height != 360 || info.num_tiles != 1)
+    return 1;
+
+  if (info.num_components != 3)
+    return 1;
+
+  for (int c = 0; c < info.num_components; c++) {
+    if (info.depths[c] != 16 || info.is_signed[c] ||
+        info.subsampling_x[c] != 1 || info.subsampling_y[c] != 1)
+      return 1;
+  }
+
+  if (info.num_levels != 5 || info.num_layers != 1 || !info.is_reversible ||
+      info.block_coder != KDU_BLOCK_CODER_LEGACY)
+    return 1;
+
+  /* truncated main headers are rejected, including one that ends right after
+     its COD marker, at byte 71 */
+
+  if (!kduc_probe(buf, 40, &info))
+    return 1;
+
+  if (!kduc_probe(buf, 71, &info))
+    return 1;
+
+  free(buf);
+
+  /* 4:2:0 8-bit codestream */
+
+  buf = read_file("resources/test.yuv.j2c", &size);
+  if (!buf) return 1;
+
+  if (kduc_probe(buf, size, &info))
+    return 1;
+
+  if (info.width != 640 || info.height != 480 || info.num_components != 3)
+    return 1;
+
+  if (info.subsampling_x[0] != 1 || info.subsampling_y[0] != 1 ||
+      info.subsampling_x[1] != 2 || info.subsampling_y[1] != 2 ||
+      info.subsampling_x[2] != 2 || info.subsampling_y[2] != 2)
+    return 1;
+
+  if (info.depths[0] != 8 || info.num_levels != 5 || info.is_reversible)
+    return 1;
+
+  free(buf);
+
+  return 0;
+}
@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) 2022, Sandflow Consulting LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <kduc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FRAME_COUNT 3
+
+static unsigned char sample_at(int frame, int i) {
+  return (unsigned char) ((i + 37 * frame) & 0xFF);
+}
+
+void print_message(const char* msg) {
+  printf("%s", msg);
+  fflush(stdout);
+}
+
+/* decodes the next frame of `seq` from `data` and compares it with `frame`
+   of the source */
+static int decode_frame(kduc_sequence_decoder* seq, const unsigned char* data,
+                        int size, int frame, int height, int width,
+                        int num_comps) {
+  kdu_codestream *cs;
+  kdu_stripe_decompressor *d;
+  int ret;
+
+  ret = kduc_sequence_decoder_start(seq, data, size, &cs, &d);
+  if (ret) return ret;
+
+  int decoded_height;
+  int decoded_width;
+
+  kdu_codestream_get_size(cs, 0, &decoded_height, &decoded_width);
+
+  if (decoded_height != height || decoded_width != width ||
+      kdu_codestream_get_num_components(cs) != num_comps)
+    return 1;
+
+  unsigned char *pixels = malloc(height * width * num_comps);
+  if (!pixels) return 1;
+
+  unsigned char *planes[3];
+  int stripe_heights[3] = {height, height, height};
+  int precisions[3] = {8, 8, 8};
+
+  for (int c = 0; c < num_comps; c++)
+    planes[c] = pixels + c * height * width;
+
+  if (!kdu_stripe_decompressor_pull_stripe_planar(d, planes, stripe_heights,
+                                                  NULL, NULL, precisions, NULL))
+    return 1;
+
+  ret = kduc_sequence_decoder_finish(seq);
+  if (ret) return ret;
+
+  for (int i = 0; i < height * width * num_comps; i++)
+    if (pixels[i] != sample_at(frame, i))
+      return 1;
+
+  free(pixels);
+
+  return 0;
+}
+
+int main(void) {
+  int height = 120;
+  int width = 160;
+  int num_comps = 3;
+  int ret;
+
+  kduc_sequence_decoder *seq;
+  kdu_siz_params *siz = NULL;
+  mem_compressed_target *targets[FRAME_COUNT];
+  unsigned char *sources[FRAME_COUNT];
+  unsigned char *copies[FRAME_COUNT];
+  int sizes[FRAME_COUNT];
+  kduc_encode_frame frames[FRAME_COUNT];
+
+  /* errors are reported by the sequence decoder rather than fatal */
+
+  kdu_register_error_handler(&print_message);
+
+  /* encode distinct frames losslessly */
+
+  ret = kdu_siz_params_new(&siz);
+  if (ret) return ret;
+
+  kdu_siz_params_set_num_components(siz, num_comps);
+  kdu_siz_params_set_precision(siz, 0, 8);
+  kdu_siz_params_set_size(siz, 0, height, width);
+  kdu_siz_params_set_signed(siz, 0, 0);
+
+  const char *params[1] = {"Creversible=yes"};
+
+  kdu_stripe_compressor_options enc_opts;
+
+  kdu_stripe_compressor_options_init(&enc_opts);
+
+  for (int i = 0; i < FRAME_COUNT; i++) {
+    sources[i] = malloc(height * width * num_comps);
+    if (!sources[i]) return 1;
+
+    for (int j = 0; j < height * width * num_comps; j++)
+      sources[i][j] = sample_at(i, j);
+
+    ret = kdu_compressed_target_mem_new(&targets[i]);
+    if (ret) return ret;
+
+    frames[i].siz = siz;
+    frames[i].params = params;
+    frames[i].param_count = 1;
+    frames[i].opts = &enc_opts;
+    frames[i].sample_type = KDUC_SAMPLE_8;
+    for (int c = 0; c < num_comps; c++)
+      frames[i].planes[c] = sources[i] + c * height * width;
+    frames[i].row_gaps = NULL;
+    frames[i].precisions = NULL;
+    frames[i].is_signed = NULL;
+    frames[i].frame_id = i;
+    frames[i].target = targets[i];
+  }
+
+  ret = kduc_encode_batch(frames, FRAME_COUNT, 1);
+  if (ret) return ret;
+
+  /* each frame is decoded from its own copy, as when read from a file */
+
+  for (int i = 0; i < FRAME_COUNT; i++) {
+    unsigned char *buf;
+
+    kdu_compressed_target_bytes(targets[i], &buf, &sizes[i]);
+
+    copies[i] = malloc(sizes[i]);
+    if (!copies[i]) return 1;
+
+    memcpy(copies[i], buf, sizes[i]);
+  }
+
+  /* decode the frames in sequence, with a corrupt frame in between that must
+     not affect the frames that follow */
+
+  kdu_stripe_decompressor_options opts;
+
+  kdu_stripe_decompressor_options_init(&opts);
+
+  ret = kduc_sequence_decoder_new(&opts, &seq);
+  if (ret) return ret;
+
+  ret = decode_frame(seq, copies[0], sizes[0], 0, height, width, num_comps);
+  if (ret) return ret;
+
+  ret = decode_frame(seq, copies[1], sizes[1], 1, height, width, num_comps);
+  if (ret) return ret;
+
+  unsigned char garbage[64];
+  kdu_codestream *cs;
+  kdu_stripe_decompressor *d;
+
+  memset(garbage, 0x5A, sizeof(garbage));
+
+  if (!kduc_sequence_decoder_start(seq, garbage, sizeof(garbage), &cs, &d))
+    return 1;
+
+  ret = decode_frame(seq, copies[2], sizes[2], 2, height, width, num_comps);
+  if (ret) return ret;
+
+  ret = decode_frame(seq, copies[0], sizes[0], 0, height, width, num_comps);
+  if (ret) return ret;
+
+  kduc_sequence_decoder_delete(seq);
+
+  for (int i = 0; i < FRAME_COUNT; i++) {
+    free(copies[i]);
+    free(sources[i]);
+    kdu_compressed_target_mem_delete(targets[i]);
+  }
+
+  kdu_siz_params_delete(siz);
+
+  return 0;
+}
@@ -0,0 +1,202 @@
+/*
+ * Copyright (c) 2022, Sandflow Consulting LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <kduc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void exit_with_error(const char* msg) {
+  printf("%s", msg);
+  fflush(stdout);
+  exit(-1);
+}
+
+/* decodes the codestream in `buf` and compares it with `pixels` */
+static int check_frame(unsigned char* buf, int buf_sz, unsigned char* pixels,
+                       int height, int width, int num_comps) {
+  kdu_compressed_source *source = NULL;
+  kdu_codestream *cs = NULL;
+  kdu_stripe_decompressor *dec = NULL;
+  kduc_info info;
+  int ret;
+
+  /* the caller's params apply to every frame, including restarted ones */
+
+  ret = kduc_probe(buf, buf_sz, &info);
+  if (ret)
+    return ret;
+
+  if (info.uses_mct || !info.is_reversible || info.num_levels != 3)
+    return 1;
+
+  ret = kdu_compressed_source_buffered_new(buf, buf_sz, &source);
+  if (ret)
+    return ret;
+
+  ret = kdu_codestream_create_from_source(source, &cs);
+  if (ret)
+    return ret;
+
+  ret = kdu_stripe_decompressor_new(&dec);
+  if (ret)
+    return ret;
+
+  kdu_stripe_decompressor_options opts;
+
+  kdu_stripe_decompressor_options_init(&opts);
+
+  ret = kdu_stripe_decompressor_start(dec, cs, &opts);
+  if (ret)
+    return ret;
+
+  unsigned char *decoded = malloc(height * width * num_comps);
+  if (! decoded)
+    return 1;
+
+  int stripe_heights[3] = {height, height, height};
+  int precisions[3] = {8, 8, 8};
+
+  if (! kdu_stripe_decompressor_pull_stripe(dec, decoded, stripe_heights, NULL,
+                                            NULL, NULL, precisions, NULL))
+    return 1;
+
+  ret = kdu_stripe_decompressor_finish(dec);
+  if (ret)
+    return ret;
+
+  /* lossless round trip */
+
+  if (memcmp(decoded, pixels, height * width * num_comps))
+    return 1;
+
+  free(decoded);
+
+  kdu_stripe_decompressor_delete(dec);
+
+  kdu_codestream_delete(cs);
+
+  kdu_compressed_source_buffered_delete(source);
+
+  return 0;
+}
+
+int main(void) {
+  int height = 480;
+  int width = 640;
+  int num_comps = 3;
+  int frame_count = 10;
+  int ret;
+
+  unsigned char *pixels;
+  kduc_sequence_encoder *seq = NULL;
+  kdu_stripe_compressor *enc = NULL;
+  kdu_siz_params *siz = NULL;
+
+  unsigned char *buf;
+  int buf_sz;
+
+  /* register message handlers */
+
+  kdu_register_error_handler(&exit_with_error);
+  kdu_register_warning_handler(&exit_with_error);
+
+  /* create image */
+
+  pixels = malloc(height * width * num_comps);
+  if (! pixels)
+    return 1;
+
+  /* initialize siz */
+
+  ret = kdu_siz_params_new(&siz);
+  if (ret)
+    return ret;
+
+  kdu_siz_params_set_num_components(siz, num_comps);
+  kdu_siz_params_set_precision(siz, 0, 8);
+  kdu_siz_params_set_size(siz, 0, height, width);
+  kdu_siz_params_set_signed(siz, 0, 0);
+
+  /* sequence encoder */
+
+  const char *params[] = {"Ctype=N", "Creversible=yes", "Clevels=3"};
+
+  kdu_stripe_compressor_options opts;
+
+  kdu_stripe_compressor_options_init(&opts);
+
+  ret = kduc_sequence_encoder_new(siz, params, 3, &opts, &seq);
+  if (ret)
+    return ret;
+
+  int stripe_heights[3] = {height, height, height};
+  int precisions[3] = {8, 8, 8};
+
+  for (int frame = 0; frame < frame_count; frame++) {
+    mem_compressed_target *target = NULL;
+
+    for(int i = 0; i < height * width * num_comps; i++)
+      pixels[i] = (unsigned char) ((i + frame) & 0xFF);
+
+    ret = kdu_compressed_target_mem_new(&target);
+    if (ret)
+      return ret;
+
+    ret = kduc_sequence_encoder_start(seq, target, &enc);
+    if (ret)
+      return ret;
+
+    int stop = 0;
+    while (!stop) {
+      stop = kdu_stripe_compressor_push_stripe(enc, pixels, stripe_heights, NULL,
+                                               NULL, NULL, precisions);
+    }
+
+    ret = kduc_sequence_encoder_finish(seq);
+    if (ret)
+      return ret;
+
+    kdu_compressed_target_bytes(target, &buf, &buf_sz);
+
+    if (buf_sz == 0)
+      return 1;
+
+    ret = check_frame(buf, buf_sz, pixels, height, width, num_comps);
+    if (ret)
+      return ret;
+
+    kdu_compressed_target_mem_delete(target);
+  }
+
+  kduc_sequence_encoder_delete(seq);
+
+  kdu_siz_params_delete(siz);
+
+  free(pixels);
+
+  return 0;
+}
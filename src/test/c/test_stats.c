@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2022, Sandflow Consulting LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <kduc.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+void exit_with_error(const char* msg) {
+  printf("%s", msg);
+  fflush(stdout);
+  exit(-1);
+}
+
+int main(void) {
+  int height = 480;
+  int width = 640;
+  int num_comps = 3;
+  int ret;
+
+  unsigned char *pixels;
+  mem_compressed_target *target = NULL;
+  kdu_codestream *cs = NULL;
+  kdu_stripe_compressor *enc = NULL;
+  kdu_siz_params *siz = NULL;
+  kdu_compressed_source *source = NULL;
+  kdu_stripe_decompressor *dec = NULL;
+
+  unsigned char *buf;
+  int buf_sz;
+
+  kduc_stripe_stats stats;
+  kduc_target_stats target_stats;
+
+  /* register message handlers */
+
+  kdu_register_error_handler(&exit_with_error);
+  kdu_register_warning_handler(&exit_with_error);
+
+  /* create image */
+
+  pixels = malloc(height * width * num_comps);
+  if (! pixels)
+    return 1;
+
+  for(int i = 0; i < height * width * num_comps; i++)
+    pixels[i] = (unsigned char) (i & 0xFF);
+
+  /* initialize siz */
+
+  ret = kdu_siz_params_new(&siz);
+  if (ret)
+    return ret;
+
+  kdu_siz_params_set_num_components(siz, num_comps);
+  kdu_siz_params_set_precision(siz, 0, 8);
+  kdu_siz_params_set_size(siz, 0, height, width);
+  kdu_siz_params_set_signed(siz, 0, 0);
+
+  /* encode in two stripes, with stats enabled */
+
+  ret = kdu_compressed_target_mem_new(&target);
+  if (ret)
+    return ret;
+
+  ret = kdu_codestream_create_from_target(target, siz, &cs);
+  if (ret)
+    return ret;
+
+  ret = kdu_stripe_compressor_new(&enc);
+  if (ret)
+    return ret;
+
+  kdu_stripe_compressor_enable_stats(enc, true);
+
+  kdu_stripe_compressor_options enc_opts;
+
+  kdu_stripe_compressor_options_init(&enc_opts);
+
+  int stripe_heights[3] = {height / 2, height / 2, height / 2};
+  int precisions[3] = {8, 8, 8};
+
+  ret = kdu_stripe_compressor_start(enc, cs, &enc_opts);
+  if (ret)
+    return ret;
+
+  int stop = 0;
+  for (int i = 0; !stop; i++) {
+    stop = kdu_stripe_compressor_push_stripe(
+        enc, pixels + i * (height / 2) * width * num_comps, stripe_heights,
+        NULL, NULL, NULL, precisions);
+  }
+
+  ret = kdu_stripe_compressor_finish(enc);
+  if (ret)
+    return ret;
+
+  kdu_stripe_compressor_get_stats(enc, &stats);
+
+  if (stats.stripe_count != 2 || stats.start_wall_ns <= 0 ||
+      stats.stripe_wall_ns <= 0 || stats.finish_wall_ns <= 0)
+    return 1;
+
+  kdu_stripe_compressor_reset_stats(enc);
+  kdu_stripe_compressor_get_stats(enc, &stats);
+
+  if (stats.stripe_count != 0 || stats.stripe_wall_ns != 0)
+    return 1;
+
+  kdu_stripe_compressor_delete(enc);
+
+  kdu_codestream_delete(cs);
+
+  kdu_compressed_target_bytes(target, &buf, &buf_sz);
+
+  kdu_compressed_target_get_stats(target, &target_stats);
+
+  if (target_stats.write_count == 0 || target_stats.bytes_written < buf_sz ||
+      target_stats.peak_size != buf_sz || target_stats.realloc_count == 0)
+    return 1;
+
+  /* decode, with stats disabled */
+
+  ret = kdu_compressed_source_buffered_new(buf, buf_sz, &source);
+  if (ret)
+    return ret;
+
+  ret = kdu_codestream_create_from_source(source, &cs);
+  if (ret)
+    return ret;
+
+  ret = kdu_stripe_decompressor_new(&dec);
+  if (ret)
+    return ret;
+
+  kdu_stripe_decompressor_options dec_opts;
+
+  kdu_stripe_decompressor_options_init(&dec_opts);
+
+  ret = kdu_stripe_decompressor_start(dec, cs, &dec_opts);
+  if (ret)
+    return ret;
+
+  stripe_heights[0] = stripe_heights[1] = stripe_heights[2] = height;
+
+  stop = 0;
+  while (!stop) {
+    stop = kdu_stripe_decompressor_pull_stripe(
+        dec, pixels, stripe_heights, NULL, NULL, NULL, precisions, NULL);
+  }
+
+  ret = kdu_stripe_decompressor_finish(dec);
+  if (ret)
+    return ret;
+
+  /* stripes are counted, but times are not collected */
+
+  kdu_stripe_decompressor_get_stats(dec, &stats);
+
+  if (stats.stripe_count != 1 || stats.stripe_wall_ns != 0)
+    return 1;
+
+  kdu_stripe_decompressor_delete(dec);
+
+  kdu_codestream_delete(cs);
+
+  kdu_compressed_source_buffered_delete(source);
+
+  kdu_compressed_target_mem_delete(target);
+
+  kdu_siz_params_delete(siz);
+
+  free(pixels);
+
+  return 0;
+}
@@ -0,0 +1,355 @@
+/*
+ * Copyright (c) 2022, Sandflow Consulting LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <kduc.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+void exit_with_error(const char* msg) {
+  printf("%s", msg);
+  fflush(stdout);
+  exit(-1);
+}
+
+int main(void) {
+  int height = 480;
+  int width = 640;
+  int num_comps = 3;
+  int frame_count = 8;
+  int ret;
+
+  unsigned char *pixels;
+  kduc_thread_pool *pool = NULL;
+
+  /* register message handlers */
+
+  kdu_register_error_handler(&exit_with_error);
+  kdu_register_warning_handler(&exit_with_error);
+
+  /* create image */
+
+  pixels = malloc(height * width * num_comps);
+  if (! pixels)
+    return 1;
+
+  for(int i = 0; i < height * width * num_comps; i++)
+    pixels[i] = (unsigned char) (i & 0xFF);
+
+  /* create a single pool shared by all encoders and decoders */
+
+  ret = kduc_thread_pool_new(4, &pool);
+  if (ret)
+    return ret;
+
+  int stripe_heights[3] = {height, height, height};
+  int precisions[3] = {8, 8, 8};
+
+  for (int frame = 0; frame < frame_count; frame++) {
+    mem_compressed_target *target = NULL;
+    kdu_codestream *cs = NULL;
+    kdu_stripe_compressor *enc = NULL;
+    kdu_siz_params *siz = NULL;
+    kdu_compressed_source *source = NULL;
+    kdu_stripe_decompressor *dec = NULL;
+
+    unsigned char *buf;
+    int buf_sz;
+
+    /* encode */
+
+    ret = kdu_siz_params_new(&siz);
+    if (ret)
+      return ret;
+
+    kdu_siz_params_set_num_components(siz, num_comps);
+    kdu_siz_params_set_precision(siz, 0, 8);
+    kdu_siz_params_set_size(siz, 0, height, width);
+    kdu_siz_params_set_signed(siz, 0, 0);
+
+    ret = kdu_compressed_target_mem_new(&target);
+    if (ret)
+      return ret;
+
+    ret = kdu_codestream_create_from_target(target, siz, &cs);
+    if (ret)
+      return ret;
+
+    ret = kdu_stripe_compressor_new(&enc);
+    if (ret)
+      return ret;
+
+    kdu_stripe_compressor_options enc_opts;
+
+    kdu_stripe_compressor_options_init(&enc_opts);
+
+    enc_opts.pool = pool;
+
+    ret = kdu_stripe_compressor_start(enc, cs, &enc_opts);
+    if (ret)
+      return ret;
+
+    int stop = 0;
+    while (!stop) {
+      stop = kdu_stripe_compressor_push_stripe(enc, pixels, stripe_heights,
+                                               NULL, NULL, NULL, precisions);
+    }
+
+    ret = kdu_stripe_compressor_finish(enc);
+    if (ret)
+      return ret;
+
+    kdu_stripe_compressor_delete(enc);
+
+    kdu_codestream_delete(cs);
+
+    kdu_siz_params_delete(siz);
+
+    kdu_compressed_target_bytes(target, &buf, &buf_sz);
+
+    if (buf_sz == 0)
+      return 1;
+
+    /* decode */
+
+    ret = kdu_compressed_source_buffered_new(buf, buf_sz, &source);
+    if (ret)
+      return ret;
+
+    ret = kdu_codestream_create_from_source(source, &cs);
+    if (ret)
+      return ret;
+
+    ret = kdu_stripe_decompressor_new(&dec);
+    if (ret)
+      return ret;
+
+    kdu_stripe_decompressor_options dec_opts;
+
+    kdu_stripe_decompressor_options_init(&dec_opts);
+
+    dec_opts.pool = pool;
+
+    ret = kdu_stripe_decompressor_start(dec, cs, &dec_opts);
+    if (ret)
+      return ret;
+
+    stop = 0;
+    while (!stop) {
+      stop = kdu_stripe_decompressor_pull_stripe(
+          dec, pixels, stripe_heights, NULL, NULL, NULL, precisions, NULL);
+    }
+
+    ret = kdu_stripe_decompressor_finish(dec);
+    if (ret)
+      return ret;
+
+    kdu_stripe_decompressor_delete(dec);
+
+    kdu_codestream_delete(cs);
+
+    kdu_compressed_source_buffered_delete(source);
+
+    kdu_compressed_target_mem_delete(target);
+  }
+
+  /* borrow the same pool from two workers at once, which take turns on it */
+
+  mem_compressed_target *targets[frame_count];
+  unsigned char *out_pixels[frame_count];
+  kduc_encode_frame enc_frames[frame_count];
+  kduc_decode_frame dec_frames[frame_count];
+  const char *params[1] = {"Creversible=yes"};
+  int plane_size = height * width;
+
+  for(int i = 0; i < height * width * num_comps; i++)
+    pixels[i] = (unsigned char) (i & 0xFF);
+
+  kdu_siz_params *siz = NULL;
+
+  ret = kdu_siz_params_new(&siz);
+  if (ret)
+    return ret;
+
+  kdu_siz_params_set_num_components(siz, num_comps);
+  kdu_siz_params_set_precision(siz, 0, 8);
+  kdu_siz_params_set_size(siz, 0, height, width);
+  kdu_siz_params_set_signed(siz, 0, 0);
+
+  kdu_stripe_compressor_options enc_opts;
+
+  kdu_stripe_compressor_options_init(&enc_opts);
+
+  enc_opts.pool = pool;
+
+  for (int i = 0; i < frame_count; i++) {
+    ret = kdu_compressed_target_mem_new(&targets[i]);
+    if (ret)
+      return ret;
+
+    enc_frames[i].siz = siz;
+    enc_frames[i].params = params;
+    enc_frames[i].param_count = 1;
+    enc_frames[i].opts = &enc_opts;
+    enc_frames[i].sample_type = KDUC_SAMPLE_8;
+    for (int c = 0; c < num_comps; c++)
+      enc_frames[i].planes[c] = pixels + c * plane_size;
+    enc_frames[i].row_gaps = NULL;
+    enc_frames[i].precisions = NULL;
+    enc_frames[i].is_signed = NULL;
+    enc_frames[i].frame_id = i;
+    enc_frames[i].target = targets[i];
+  }
+
+  ret = kduc_encode_batch(enc_frames, frame_count, 2);
+  if (ret)
+    return ret;
+
+  kdu_stripe_decompressor_options dec_opts;
+
+  kdu_stripe_decompressor_options_init(&dec_opts);
+
+  dec_opts.pool = pool;
+
+  for (int i = 0; i < frame_count; i++) {
+    unsigned char *buf;
+    int buf_sz;
+
+    kdu_compressed_target_bytes(targets[i], &buf, &buf_sz);
+
+    out_pixels[i] = malloc(height * width * num_comps);
+    if (! out_pixels[i])
+      return 1;
+
+    dec_frames[i].data = buf;
+    dec_frames[i].size = buf_sz;
+    dec_frames[i].opts = &dec_opts;
+    dec_frames[i].sample_type = KDUC_SAMPLE_8;
+    for (int c = 0; c < num_comps; c++)
+      dec_frames[i].planes[c] = out_pixels[i] + c * plane_size;
+    dec_frames[i].row_gaps = NULL;
+    dec_frames[i].precisions = NULL;
+    dec_frames[i].is_signed = NULL;
+    dec_frames[i].frame_id = i;
+  }
+
+  ret = kduc_decode_batch(dec_frames, frame_count, 2);
+  if (ret)
+    return ret;
+
+  /* drive two decompressors on the pool at once from this thread, pulling
+     their stripes in turn */
+
+  kdu_compressed_source *sources[2];
+  kdu_codestream *codestreams[2];
+  kdu_stripe_decompressor *decs[2];
+  unsigned char *job_pixels[2];
+  int stops[2] = {0, 0};
+  int rows = 0;
+
+  for (int k = 0; k < 2; k++) {
+    ret = kdu_compressed_source_buffered_new(dec_frames[k].data,
+                                             dec_frames[k].size, &sources[k]);
+    if (ret)
+      return ret;
+
+    ret = kdu_codestream_create_from_source(sources[k], &codestreams[k]);
+    if (ret)
+      return ret;
+
+    ret = kdu_stripe_decompressor_new(&decs[k]);
+    if (ret)
+      return ret;
+
+    ret = kdu_stripe_decompressor_start(decs[k], codestreams[k], &dec_opts);
+    if (ret)
+      return ret;
+
+    job_pixels[k] = malloc(height * width * num_comps);
+    if (! job_pixels[k])
+      return 1;
+  }
+
+  while (rows < height) {
+    int stripe_height = height - rows < 16 ? height - rows : 16;
+    int heights[3] = {stripe_height, stripe_height, stripe_height};
+
+    for (int k = 0; k < 2; k++) {
+      unsigned char *planes[3];
+
+      if (stops[k])
+        return 1;
+
+      for (int c = 0; c < num_comps; c++)
+        planes[c] = job_pixels[k] + c * plane_size + rows * width;
+
+      stops[k] = kdu_stripe_decompressor_pull_stripe_planar(
+          decs[k], planes, heights, NULL, NULL, precisions, NULL);
+    }
+
+    rows += stripe_height;
+  }
+
+  for (int k = 0; k < 2; k++) {
+    if (! stops[k])
+      return 1;
+
+    ret = kdu_stripe_decompressor_finish(decs[k]);
+    if (ret)
+      return ret;
+
+    for (int j = 0; j < height * width * num_comps; j++)
+      if (job_pixels[k][j] != pixels[j])
+        return 1;
+
+    free(job_pixels[k]);
+
+    kdu_stripe_decompressor_delete(decs[k]);
+
+    kdu_codestream_delete(codestreams[k]);
+
+    kdu_compressed_source_buffered_delete(sources[k]);
+  }
+
+  for (int i = 0; i < frame_count; i++) {
+    for (int j = 0; j < height * width * num_comps; j++)
+      if (out_pixels[i][j] != pixels[j])
+        return 1;
+
+    free(out_pixels[i]);
+
+    kdu_compressed_target_mem_delete(targets[i]);
+  }
+
+  kdu_siz_params_delete(siz);
+
+  /* the last borrower of the pool may have been a batch worker thread */
+
+  kduc_thread_pool_delete(pool);
+
+  free(pixels);
+
+  return 0;
+}
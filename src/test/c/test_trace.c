@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2022, Sandflow Consulting LLC
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <kduc.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define EVENT_COUNT (KDUC_TRACE_CODESTREAM_DESTROY + 1)
+
+typedef struct trace_counts {
+  int begin[EVENT_COUNT];
+  int end[EVENT_COUNT];
+  int bad_frame_id;
+} trace_counts;
+
+void exit_with_error(const char* msg) {
+  printf("%s", msg);
+  fflush(stdout);
+  exit(-1);
+}
+
+void on_trace(void* user, kduc_trace_event event, bool is_begin,
+              uint64_t frame_id) {
+  trace_counts *counts = user;
+
+  if (is_begin)
+    counts->begin[event]++;
+  else
+    counts->end[event]++;
+
+  if (event <= KDUC_TRACE_COMPRESSOR_FINISH && frame_id != 42)
+    counts->bad_frame_id = 1;
+}
+
+int main(void) {
+  int height = 480;
+  int width = 640;
+  int num_comps = 3;
+  int ret;
+
+  unsigned char *pixels;
+  mem_compressed_target *target = NULL;
+  kdu_codestream *cs = NULL;
+  kdu_stripe_compressor *enc = NULL;
+  kdu_siz_params *siz = NULL;
+
+  trace_counts counts = {{0}, {0}, 0};
+
+  /* register message handlers */
+
+  kdu_register_error_handler(&exit_with_error);
+  kdu_register_warning_handler(&exit_with_error);
+
+  kduc_register_trace_handler(&on_trace, &counts);
+
+  /* create image */
+
+  pixels = malloc(height * width * num_comps);
+  if (! pixels)
+    return 1;
+
+  for(int i = 0; i < height * width * num_comps; i++)
+    pixels[i] = (unsigned char) (i & 0xFF);
+
+  /* initialize siz */
+
+  ret = kdu_siz_params_new(&siz);
+  if (ret)
+    return ret;
+
+  kdu_siz_params_set_num_components(siz, num_comps);
+  kdu_siz_params_set_precision(siz, 0, 8);
+  kdu_siz_params_set_size(siz, 0, height, width);
+  kdu_siz_params_set_signed(siz, 0, 0);
+
+  /* encode in two stripes */
+
+  ret = kdu_compressed_target_mem_new(&target);
+  if (ret)
+    return ret;
+
+  ret = kdu_codestream_create_from_target(target, siz, &cs);
+  if (ret)
+    return ret;
+
+  ret = kdu_stripe_compressor_new(&enc);
+  if (ret)
+    return ret;
+
+  kdu_stripe_compressor_set_frame_id(enc, 42);
+
+  kdu_stripe_compressor_options opts;
+
+  kdu_stripe_compressor_options_init(&opts);
+
+  int stripe_heights[3] = {height / 2, height / 2, height / 2};
+  int precisions[3] = {8, 8, 8};
+
+  ret = kdu_stripe_compressor_start(enc, cs, &opts);
+  if (ret)
+    return ret;
+
+  int stop = 0;
+  for (int i = 0; !stop; i++) {
+    stop = kdu_stripe_compressor_push_stripe(
+        enc, pixels + i * (height / 2) * width * num_comps, stripe_heights,
+        NULL, NULL, NULL, precisions);
+  }
+
+  ret = kdu_stripe_compressor_finish(enc);
+  if (ret)
+    return ret;
+
+  kdu_stripe_compressor_delete(enc);
+
+  kdu_codestream_delete(cs);
+
+  kduc_register_trace_handler(NULL, NULL);
+
+  /* every event that began has ended */
+
+  for (int i = 0; i < EVENT_COUNT; i++) {
+    if (counts.begin[i] != counts.end[i])
+      return 1;
+  }
+
+  if (counts.begin[KDUC_TRACE_CODESTREAM_CREATE] != 1 ||
+      counts.begin[KDUC_TRACE_COMPRESSOR_START] != 1 ||
+      counts.begin[KDUC_TRACE_COMPRESSOR_PUSH_STRIPE] != 2 ||
+      counts.begin[KDUC_TRACE_COMPRESSOR_FINISH] != 1 ||
+      counts.begin[KDUC_TRACE_CODESTREAM_DESTROY] != 1 ||
+      counts.bad_frame_id)
+    return 1;
+
+  kdu_compressed_target_mem_delete(target);
+
+  kdu_siz_params_delete(siz);
+
+  free(pixels);
+
+  return 0;
+}